@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "../include/scan.h"
+
+// Times the scalar, SSE2 and AVX2 scanners over one generated input and
+// checks that they all split and hash it the same way.
+//
+//   scan_bench [megabytes]
+
+#define SCAN_BENCH_RUNS 5
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+
+static uint64_t rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static char *generate(size_t size)
+{
+    static const char alpha[] = 
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    static const char word[] = 
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+    static const char blank[] = "    \t\n\r";
+    static const char punct[] = "+-*/=<>!&|()[]{};,.@";
+
+    char *result = malloc(size);
+    size_t i = 0;
+
+    while (i < size) {
+        size_t kind = rng() % 4;
+        // Mostly short runs, now and then one longer than a vector
+        size_t len = rng() % 8 == 0 ? 1 + rng() % 64 : 1 + rng() % 10;
+
+        for (size_t j = 0; j < len && i < size; j++, i++) {
+            switch (kind) {
+            case 0:
+                result[i] = j == 0 
+                    ? alpha[rng() % (sizeof alpha - 1)]
+                    : word[rng() % (sizeof word - 1)];
+                break;
+            case 1:
+                result[i] = '0' + rng() % 10;
+                break;
+            case 2:
+                result[i] = blank[rng() % (sizeof blank - 1)];
+                break;
+            default:
+                result[i] = punct[rng() % (sizeof punct - 1)];
+                break;
+            }
+        }
+
+        // Keeps a word from running into the next run
+        if (i < size)
+            result[i++] = ' ';
+    }
+
+    return result;
+}
+
+// Walks the input like the lexer does, returns a sum over every lexeme
+static uint64_t scan_all(char *source, size_t size, size_t *count)
+{
+    char *curr = source;
+    char *end = source + size;
+    uint64_t result = 0;
+    *count = 0;
+
+    while (curr != end) {
+        char *start = curr;
+        size_t hash = 0;
+        long value = 0;
+
+        if (scan_is(*curr, SCAN_BLANK))
+            curr = scan_blanks(curr, end);
+        else if (scan_is(*curr, SCAN_ALPHA))
+            curr = scan_word(curr, end, &hash);
+        else if (scan_is(*curr, SCAN_DIGIT))
+            curr = scan_number(curr, end, &value, &hash);
+        else
+            curr++;
+
+        result = result * 31 + hash + (uint64_t) value + 
+            (uint64_t) (curr - start);
+        (*count)++;
+    }
+
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    size_t megabytes = argc > 1 ? strtoul(argv[1], NULL, 10) : 64;
+    size_t size = megabytes * 1024 * 1024;
+    char *source = generate(size);
+
+    static const char *names[] = { "scalar", "sse2", "avx2" };
+    bool has_expected = false;
+    uint64_t expected = 0;
+    size_t expected_count = 0;
+    int result = 0;
+
+    for (int level = SCAN_SCALAR; level <= SCAN_AVX2; level++) {
+        if (!scan_use(level)) {
+            printf("%-8s not supported\n", names[level]);
+            continue;
+        }
+
+        double best = 0;
+        uint64_t sum = 0;
+        size_t count = 0;
+
+        for (int run = 0; run < SCAN_BENCH_RUNS; run++) {
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            sum = scan_all(source, size, &count);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            double seconds = (end.tv_sec - start.tv_sec) + 
+                (end.tv_nsec - start.tv_nsec) / 1e9;
+            if (run == 0 || seconds < best)
+                best = seconds;
+        }
+
+        printf("%-8s %8.1f MB/s  %zu lexemes\n", names[level], 
+               size / best / 1e6, count);
+
+        if (!has_expected) {
+            expected = sum;
+            expected_count = count;
+            has_expected = true;
+        }
+        else if (sum != expected || count != expected_count) {
+            printf("%-8s differs from scalar\n", names[level]);
+            result = 1;
+        }
+    }
+
+    free(source);
+    return result;
+}
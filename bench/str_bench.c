@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../include/str.h"
+
+// Times the interner on one thread: inserting new strings, looking up
+// strings it holds (hits), interning new strings into a full table
+// (misses), and a lexer-like mix of mostly hits. Every phase walks the
+// strings in the order they were inserted. Checks that every hit returns
+// the ID the string was first interned as. Ends with the bytes the
+// interner holds per string.
+//
+//   str_bench [strings]
+
+#define STR_BENCH_ROUNDS 4
+// Out of 100 lookups in the mix, like the names in a typical source
+#define STR_BENCH_MIX_HITS 90
+
+typedef struct Name {
+    char chars[32];
+    size_t len;
+} Name;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15;
+
+static uint64_t rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Distinct identifiers of 3 to about 20 characters, the number makes them
+// unique
+static Name *generate(size_t count, char prefix)
+{
+    static const char alpha[] = "abcdefghijklmnopqrstuvwxyz_";
+    Name *result = malloc(count * sizeof *result);
+
+    for (size_t i = 0; i < count; i++) {
+        Name *name = &result[i];
+        size_t len = rng() % 10;
+
+        name->chars[0] = prefix;
+        for (size_t j = 1; j <= len; j++)
+            name->chars[j] = alpha[rng() % (sizeof alpha - 1)];
+        name->len = len + 1 + sprintf(name->chars + len + 1, "%zu", i);
+    }
+
+    return result;
+}
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+static void report(char *name, size_t ops, double seconds)
+{
+    printf("%-8s %8.1f M/s  %6.1f ns\n", name, ops / seconds / 1e6,
+           seconds * 1e9 / ops);
+}
+
+static void report_memory()
+{
+    StrStats stats;
+    str_stats(&stats);
+    if (stats.count == 0)
+        return;
+
+    size_t bytes = stats.table_bytes + stats.string_bytes + 
+        stats.entry_bytes;
+    printf("memory   %8.1f B per string (table %.1f, strings %.1f, "
+           "entries %.1f), and %.1f in retired tables\n", 
+           (double) bytes / stats.count, 
+           (double) stats.table_bytes / stats.count,
+           (double) stats.string_bytes / stats.count,
+           (double) stats.entry_bytes / stats.count, 
+           (double) stats.retired_bytes / stats.count);
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    Name *names = generate(count, 'a');
+    Name *misses = generate(count, 'b');
+    Name *mixed = generate(count, 'c');
+    StrId *ids = malloc(count * sizeof *ids);
+    int result = 0;
+
+    str_init(NULL, 0);
+
+    double start = now();
+    for (size_t i = 0; i < count; i++)
+        ids[i] = str_intern(names[i].chars, names[i].len);
+    report("insert", count, now() - start);
+
+    start = now();
+    for (size_t round = 0; round < STR_BENCH_ROUNDS; round++) {
+        for (size_t i = 0; i < count; i++) {
+            if (str_intern(names[i].chars, names[i].len) != ids[i])
+                result = 1;
+        }
+    }
+    report("hit", STR_BENCH_ROUNDS * count, now() - start);
+
+    start = now();
+    for (size_t i = 0; i < count; i++)
+        str_intern(misses[i].chars, misses[i].len);
+    report("miss", count, now() - start);
+
+    size_t mixed_count = 0;
+    start = now();
+    for (size_t i = 0; i < count; i++) {
+        if (i % 100 < STR_BENCH_MIX_HITS) {
+            if (str_intern(names[i].chars, names[i].len) != ids[i])
+                result = 1;
+        }
+        else {
+            Name *name = &mixed[mixed_count++];
+            str_intern(name->chars, name->len);
+        }
+    }
+    report("mixed", count, now() - start);
+
+    for (size_t i = 0; i < count; i++) {
+        if (str_len(str_chars(ids[i])) != names[i].len ||
+            memcmp(str_chars(ids[i]), names[i].chars, names[i].len))
+            result = 1;
+    }
+
+    report_memory();
+
+    if (result != 0)
+        printf("lookups returned the wrong strings\n");
+
+    str_deinit();
+    free(ids);
+    free(mixed);
+    free(misses);
+    free(names);
+    return result;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "../include/str.h"
+
+// Times interning on 1, 2, 4, ... up to the given number of threads. Every
+// thread interns the same number of names, mostly from a pool all threads
+// share and one in ten of its own, like lexers on chunks of one source.
+//
+//   str_threads_bench [max threads] [interns per thread]
+
+#define STR_BENCH_POOL 50000
+// Out of 10 interns, the rest are new names of the thread
+#define STR_BENCH_POOL_HITS 9
+
+typedef struct BenchThread {
+    pthread_t thread;
+    size_t index;
+    size_t count;
+} BenchThread;
+
+static char pool[STR_BENCH_POOL][24];
+static pthread_barrier_t start;
+
+static void *str_bench_run(void *arg)
+{
+    BenchThread *thread = arg;
+    char name[32];
+
+    pthread_barrier_wait(&start);
+
+    for (size_t i = 0; i < thread->count; i++) {
+        if (i % 10 < STR_BENCH_POOL_HITS) {
+            size_t j = (i * 7919 + thread->index * 104729) % STR_BENCH_POOL;
+            str_intern_null_term(pool[j]);
+        }
+        else {
+            sprintf(name, "t%zu_%zu", thread->index, i);
+            str_intern_null_term(name);
+        }
+    }
+
+    return NULL;
+}
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    size_t max_threads = argc > 1 ? strtoul(argv[1], NULL, 10) : 32;
+    size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    BenchThread *threads = malloc(max_threads * sizeof *threads);
+    double single = 0;
+
+    for (size_t i = 0; i < STR_BENCH_POOL; i++)
+        sprintf(pool[i], "name_%zx", i * 2654435761u);
+
+    for (size_t jobs = 1; jobs <= max_threads; jobs *= 2) {
+        str_init(NULL, 0);
+        // One more for the timing thread, so all start together
+        pthread_barrier_init(&start, NULL, jobs + 1);
+
+        for (size_t i = 0; i < jobs; i++) {
+            threads[i].index = i;
+            threads[i].count = count;
+            pthread_create(&threads[i].thread, NULL, str_bench_run, 
+                           &threads[i]);
+        }
+
+        pthread_barrier_wait(&start);
+        double begin = now();
+        for (size_t i = 0; i < jobs; i++)
+            pthread_join(threads[i].thread, NULL);
+        double seconds = now() - begin;
+
+        pthread_barrier_destroy(&start);
+        str_deinit();
+
+        double rate = jobs * count / seconds;
+        if (jobs == 1)
+            single = rate;
+        printf("%2zu threads %8.1f M/s  %5.2fx\n", jobs, rate / 1e6, 
+               rate / single);
+    }
+
+    free(threads);
+    return 0;
+}
@@ -2,8 +2,11 @@
 #define C0_AST_H
 
 #include "./token.h"
+#include "./data_structures/arena.h"
 #include "symbol_table.h"
 
+#define AST_ARENA_BLOCK_SIZE (64 * 1024)
+
 typedef enum ExprType {
     ET_BINARY,
     ET_UNARY,
@@ -15,18 +18,23 @@ typedef enum ExprType {
     ET_BC,
     ET_CC,
     ET_NA,
-    ET_NULL
+    ET_NULL,
+
+    // Only made by lowering
+    ET_PATH
 } ExprType;
 
 typedef struct Expr Expr;
 
+typedef struct PathIndex {
+    Expr *index;
+    size_t scale;
+} PathIndex;
+
 struct Expr {
     ExprType type;
     Location loc;
 
-    bool has_value;
-    TokenValue value;
-
     union {
         struct {
             TokenType op;
@@ -38,7 +46,7 @@ struct Expr {
         } unary;
         struct {
             Expr *left;
-            char *na;
+            StrId na;
         } access;
         struct {
             Expr *left, *index;
@@ -46,7 +54,20 @@ struct Expr {
         bool bc;
         long c;
         char cc;
-        char *na;
+        struct {
+            StrId name;
+            Symbol *sym; // NULL if the name is undefined
+        } na;
+        // The object at base + offset + the sum of index * scale, where
+        // base is the address of sym, or else the value of pointer
+        struct {
+            Symbol *sym;
+            Expr *pointer;
+            long offset;
+            PathIndex *indices;
+            size_t indices_count;
+            Type *type; // Of the object
+        } path;
     } as;
 };
 
@@ -78,56 +99,66 @@ struct Stmt {
         } while_stmt;
         struct {
             Expr *left;
-            char *na;
+            StrId na;
+            Symbol *sym; // NULL if the function is undefined
             Expr **args;
         } funcall;
         struct {
             Expr *left;
-            char *na;
+            StrId na;
         } new_stmt;
         Expr *return_stmt;
     } as;
 };
 
 typedef struct Function {
-    char *name;
+    StrId name;
     Type *return_type;
     Type **arg_types;
     size_t arg_count;
 
-    SymTable *table;
+    // Arguments, then locals
+    Symbol **locals;
+    size_t locals_count;
     Stmt **stmts;
     Stmt *return_stmt;
 } Function;
 
+// Nodes, child lists and path indices are bump allocated and are never
+// freed one by one. ast_reset releases all of them at once, keeping the
+// memory for the next translation unit, and ast_deinit for good.
+void ast_init();
+void ast_reset();
+void ast_deinit();
+void *ast_alloc(size_t size);
+void *ast_realloc(void *ptr, size_t old_size, size_t new_size);
+
 Expr *expr_binary(TokenType op, Expr *left, Expr *right);
-Expr *expr_unary(TokenType op, Expr *e, size_t column, bool is_prefix);
+Expr *expr_unary(TokenType op, Expr *e, uint32_t at, bool is_prefix);
 Expr *expr_access(Token *na, Expr *left);
-Expr *expr_arr_access(Expr *left, Expr *index, size_t column_end);
+Expr *expr_arr_access(Expr *left, Expr *index, uint32_t end);
 Expr *expr_c(Token *c);
 Expr *expr_bc(Token *bc);
 Expr *expr_cc(Token *cc);
 Expr *expr_null(Token *c);
-Expr *expr_na(Token *na);
-
-void exprs_free(Expr **exprs);
-void expr_free(Expr *e);
+Expr *expr_na(Token *na, Symbol *sym);
+Expr *expr_path(Symbol *sym, Expr *pointer, Type *type, Location *loc);
+void expr_path_index(Expr *path, Expr *index, size_t scale);
 
 Stmt *stmt_assign(Expr *left, Expr *right);
 Stmt *stmt_if(Expr *cond, Stmt **then_block, 
-              Stmt **else_block, size_t start_column);
-Stmt *stmt_while(Expr *cond, Stmt **block, size_t start_column);
-Stmt *stmt_funcall(Expr *left, Token *na, Expr **args, size_t end_column);
-Stmt *stmt_new(Expr *left, Token *na, size_t end_column);
-Stmt *stmt_return(Expr *expr, size_t start_column);
-
-void stmts_free(Stmt **stmts);
-void stmt_free(Stmt *stmt);
-
-Function *function_create(char *name, Type **arg_types, 
-                          size_t arg_count, SymTable *table, 
-                          Stmt **stmts, Type *return_type, 
-                          Stmt *return_stmt);
+              Stmt **else_block, uint32_t start);
+Stmt *stmt_while(Expr *cond, Stmt **block, uint32_t start);
+Stmt *stmt_funcall(Expr *left, Token *na, Symbol *sym,
+                   Expr **args, uint32_t end);
+Stmt *stmt_new(Expr *left, Token *na, uint32_t end);
+Stmt *stmt_return(Expr *expr, uint32_t start);
+
+Function *function_create(StrId name, Type **arg_types, 
+                          size_t arg_count, Symbol **locals, 
+                          size_t locals_count, Stmt **stmts, 
+                          Type *return_type, Stmt *return_stmt);
+// Its statements stay in the AST arena
 void function_free(Function *fun);
 
 #endif
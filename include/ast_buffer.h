@@ -0,0 +1,80 @@
+#ifndef C0_AST_BUFFER_H
+#define C0_AST_BUFFER_H
+
+#include <stdint.h>
+#include "./ast.h"
+
+#define AST_NONE UINT32_MAX
+
+typedef uint32_t AstNode;
+
+// Expressions keep their ExprType, statements are AK_STMT plus their
+// StmtType
+typedef enum AstKind {
+    AK_STMT = ET_PATH + 1,
+    AK_LIST = AK_STMT + ST_RETURN + 1
+} AstKind;
+
+// Compact form of the tree as parallel arrays, one entry per node. Nodes
+// are added children first, so a pass can walk them in index order.
+//
+//   kind          lhs                 rhs
+//   ET_BINARY     left                right
+//   ET_UNARY      operand
+//   ET_ACCESS     left                field name
+//   ET_ARR_ACCESS left                index
+//   ET_C          low 32 bits         high 32 bits
+//   ET_BC, ET_CC  value
+//   ET_NA         name                entry in syms, AST_NONE if undefined
+//   assign        left                right
+//   if            cond                list of then and else lists
+//   while         cond                list
+//   funcall       left                list of callee name, then arguments
+//   new           left                type name
+//   return        expr
+//   AK_LIST       offset in lists     count
+//
+// Lowered paths have no compact form, trees with any are not added. Every
+// symbol is in syms once, however many names refer to it.
+typedef struct AstBuffer {
+    size_t size;
+    size_t allocated;
+
+    unsigned char *kinds;
+    unsigned char *ops;
+    AstNode *lhs;
+    AstNode *rhs;
+    Location *locs;
+
+    AstNode *lists;
+    size_t lists_size;
+    size_t lists_allocated;
+
+    Symbol **syms;
+    size_t syms_size;
+    size_t syms_allocated;
+
+    // Open addressing from symbol to its entry in syms, AST_NONE if empty
+    AstNode *sym_slots;
+    size_t sym_slots_allocated;
+
+    bool has_path; // Met while adding the current tree
+} AstBuffer;
+
+void ast_buffer_create(AstBuffer *buffer, size_t initial_size);
+void ast_buffer_destroy(AstBuffer *buffer);
+
+// Conversion from and to Expr and Stmt trees, which are made in the AST
+// arena. Adding returns AST_NONE, and adds no nodes, if the tree has been
+// lowered.
+AstNode ast_buffer_add_expr(AstBuffer *buffer, Expr *e);
+AstNode ast_buffer_add_stmt(AstBuffer *buffer, Stmt *stmt);
+AstNode ast_buffer_add_stmts(AstBuffer *buffer, Stmt **stmts);
+// A list of the statements of fun, then its return statement
+AstNode ast_buffer_add_function(AstBuffer *buffer, Function *fun);
+
+Expr *ast_buffer_expr(AstBuffer *buffer, AstNode node);
+Stmt *ast_buffer_stmt(AstBuffer *buffer, AstNode node);
+Stmt **ast_buffer_stmts(AstBuffer *buffer, AstNode list);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef C0_ARENA_H
+#define C0_ARENA_H
+
+#include <stddef.h>
+#include "../utils.h"
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+typedef struct ArenaBlock ArenaBlock;
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+// Bump allocator. Memory is only given back all at once, by a reset.
+// Each new block is twice the size of the last, so n bytes take
+// O(log n) mallocs.
+typedef struct Arena {
+    ArenaBlock *blocks; // Newest first
+    unsigned char *curr;
+    unsigned char *end;
+    size_t block_size;
+} Arena;
+
+void arena_create(Arena *arena, size_t block_size);
+void arena_destroy(Arena *arena);
+
+void *arena_alloc(Arena *arena, size_t size);
+// Grows in place if ptr is the last allocation and there is room
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+
+// Frees every block but the newest, which is reused
+void arena_reset(Arena *arena);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef C0_SPSC_QUEUE_H
+#define C0_SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include "../utils.h"
+
+#define SPSC_QUEUE_BATCH 64
+#define SPSC_QUEUE_CACHE_LINE 64
+// Yields before a waiting side goes to sleep
+#define SPSC_QUEUE_SPINS 16
+
+// Lock-free single-producer/single-consumer ring. Each side works on a
+// private index and only publishes it every SPSC_QUEUE_BATCH elements,
+// or before it has to wait on the other side. A side that keeps waiting
+// sleeps on wakeup until the other one publishes or closes the queue.
+typedef struct SpscQueue {
+    unsigned char *data;
+    size_t element_size;
+    size_t allocated_elements; // Always power of 2
+
+    atomic_bool closed;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    atomic_bool is_producer_waiting;
+    atomic_bool is_consumer_waiting;
+
+    _Alignas(SPSC_QUEUE_CACHE_LINE) atomic_size_t tail;
+    size_t producer_tail;
+    size_t producer_head;
+
+    _Alignas(SPSC_QUEUE_CACHE_LINE) atomic_size_t head;
+    size_t consumer_head;
+    size_t consumer_tail;
+} SpscQueue;
+
+void spsc_queue_create(SpscQueue *queue,
+                       size_t element_size,
+                       size_t allocated_elements);
+void spsc_queue_destroy(SpscQueue *queue);
+
+// Push fails once the queue is closed, pop once it is closed and drained
+bool spsc_queue_push(SpscQueue *queue, void *element);
+bool spsc_queue_pop(SpscQueue *queue, void *dest);
+
+void spsc_queue_flush(SpscQueue *queue);
+void spsc_queue_close(SpscQueue *queue);
+
+#endif
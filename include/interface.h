@@ -0,0 +1,91 @@
+#ifndef C0_INTERFACE_H
+#define C0_INTERFACE_H
+
+#include <stdint.h>
+#include "./type.h"
+#include "./symbol_table.h"
+
+// Interface files hold the type table and the global variables of a
+// translation unit, so units sharing its declarations can import them
+// instead of parsing them again. Every reference in a file is an index
+// or an offset from its start. An import maps the file, checks it, interns
+// its strings and copies its records into new types and symbols, and then
+// unmaps it.
+//
+// Layouts depend on the target, -freorder-fields and -fkeep-layout, so
+// the file records them and an import with other settings fails.
+
+#define INTERFACE_MAGIC 0x69306300 // "\0c0i"
+#define INTERFACE_VERSION 3
+#define INTERFACE_NONE UINT32_MAX
+
+typedef struct InterfaceHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t target; // String naming the target the layouts are for
+    uint32_t reorder_fields;
+
+    uint32_t strings_count;
+    uint32_t types_count;
+    uint32_t fields_count;
+    uint32_t names_count;
+    uint32_t globals_count;
+    uint32_t kept_layouts_count;
+
+    // Section offsets. String i is chars[strings[i], strings[i + 1] - 1),
+    // null terminated.
+    uint64_t strings;
+    uint64_t chars;
+    uint64_t chars_size;
+    uint64_t types;
+    uint64_t fields;
+    uint64_t names;
+    uint64_t globals;
+    uint64_t kept_layouts; // Strings naming the structs -fkeep-layout kept
+} InterfaceHeader;
+
+// Indexed by Type.id, the primitive types come first
+typedef struct InterfaceType {
+    uint32_t name; // String
+    uint32_t op;
+    uint32_t child; // Type
+    uint32_t canonical; // Type
+
+    uint64_t size;
+    uint64_t align;
+    uint64_t elements;
+    uint64_t declared_size;
+
+    uint32_t fields; // First of fields_count
+    uint32_t fields_count;
+    uint32_t is_defined;
+    uint32_t reserved;
+} InterfaceType;
+
+typedef struct InterfaceField {
+    uint32_t name; // String
+    uint32_t type;
+    uint64_t offset;
+} InterfaceField;
+
+// What type_get returns for a name
+typedef struct InterfaceName {
+    uint32_t name; // String
+    uint32_t type;
+} InterfaceName;
+
+typedef struct InterfaceGlobal {
+    uint32_t name; // String
+    uint32_t type;
+    uint32_t file_path; // String
+    uint32_t start, end; // Offsets from the start of the file
+    uint32_t reserved;
+} InterfaceGlobal;
+
+// Writes every type and every global variable declared so far
+bool interface_emit(char *path);
+// Adds the types and global variables of the file. Only the primitive
+// types may have been made before.
+bool interface_import(char *path);
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include "./source.h"
 
 #define log_info(...)  log_print(LOG_INFO, __VA_ARGS__)
 #define log_warn(...)  log_print(LOG_WARN, __VA_ARGS__)
@@ -15,11 +16,6 @@
 #define log_error_with_loc(...) log_print_with_location(LOG_ERROR, __VA_ARGS__)
 #define log_fatal_with_loc(...) log_print_with_location(LOG_FATAL, __VA_ARGS__)
 
-typedef struct Location {
-    char *file_path;
-    size_t line, column_start, column_end;
-} Location;
-
 typedef enum LogType {
     LOG_INFO = 0,
     LOG_WARN,
@@ -29,7 +25,26 @@ typedef enum LogType {
     LOG_TYPE_COUNT // Always keep this as the last entry
 } LogType;
 
+typedef enum LogFormat {
+    LOG_FORMAT_TEXT,
+    LOG_FORMAT_JSON // One JSON object per line, no source lines
+} LogFormat;
+
+extern LogFormat log_format;
+// Stops the compiler on this many errors, 0 for no limit
+extern size_t log_error_limit;
+
+// Messages are collected and written in source order, in one go, by
+// log_flush. It is also called at exit.
 void log_init(bool no_colors);
+void log_flush();
+
+// Messages of type logged so far
+size_t log_count(LogType type);
+
+// True once log_error_limit errors were logged. Later messages are dropped,
+// the lexer and the parser act as if the input ended there.
+bool log_stopped();
 
 void log_print(LogType type, const char *format, ...);
 void log_print_with_location(LogType type, Location *location,
@@ -0,0 +1,77 @@
+#ifndef C0_SOURCE_H
+#define C0_SOURCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Streamed input cannot be read again, so its text is kept from this many
+// lines before where the lexer stands, for printing under diagnostics
+#define SOURCE_KEPT_LINES 64
+
+// Every input file is given the next range of 32-bit source offsets, so
+// one offset tells both the file and the place in it. Lines and columns
+// are only worked out when a diagnostic is printed.
+
+// Offsets of the first and the last character. The end of a file is at
+// its size past its first offset.
+typedef struct Location {
+    uint32_t start, end;
+} Location;
+
+typedef struct SourceFile {
+    char *path;
+    // Canonical path, NULL for input that is not a file on disk
+    char *real_path;
+    uint32_t base; // Offset of its first character
+    size_t size;
+
+    // Whole text, NULL for streamed input and until it is read back
+    const char *text;
+    bool is_owned;
+    bool is_streamed;
+
+    // Offset from base of every line start, lines[0] is 0. Built on first
+    // use, or as the text comes in for streamed input.
+    uint32_t *lines;
+    size_t lines_count;
+    size_t lines_allocated;
+    bool is_indexed;
+
+    // Streamed text kept, from history_start on
+    char *history;
+    size_t history_start;
+    size_t history_size;
+    size_t history_allocated;
+} SourceFile;
+
+typedef struct SourcePosition {
+    SourceFile *file;
+    size_t line, column; // From 1
+    size_t line_length; // Without the newline
+} SourcePosition;
+
+void source_init();
+void source_deinit();
+
+// text stays the caller's, until source_drop_text. NULL if the offsets
+// have run out.
+SourceFile *source_add(char *path, const char *text, size_t size);
+// Input read piece by piece, in order. It has to be the last file added.
+SourceFile *source_add_stream(char *path);
+bool source_append(SourceFile *file, const char *text, size_t size);
+// Streamed text before offset is no longer needed by the lexer
+void source_release(SourceFile *file, uint32_t offset);
+// Later lookups read the text back from the path
+void source_drop_text(SourceFile *file);
+// The file added for path, or for another path to the same file, or else
+// a new one with the size it has on disk
+SourceFile *source_find(char *path);
+
+SourceFile *source_file(uint32_t offset);
+SourcePosition source_position(uint32_t offset);
+// Copy of a line with its newline, NULL if it is no longer kept. Only the
+// first lookup in a file that was dropped reads it again.
+char *source_line(SourceFile *file, size_t line);
+
+#endif
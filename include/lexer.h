@@ -3,19 +3,86 @@
 
 #include "./utils.h"
 #include "./token.h"
+#include "./token_buffer.h"
+#include "./data_structures/spsc_queue.h"
+#include <pthread.h>
+
+#define LEXER_PIPELINE_SIZE 4096
+// Parallel lexing never splits the input into chunks smaller than this
+#define LEXER_MIN_CHUNK_SIZE (256 * 1024)
+// Input that cannot be mapped (stdin, pipes) is read through a window of at
+// least this size, refilled whenever less than a lookahead is left to scan
+#define LEXER_STREAM_WINDOW (64 * 1024)
+#define LEXER_STREAM_LOOKAHEAD 4096
 
 typedef struct Lexer {
-    FILE *input_stream;
     char *input_path;
-    size_t line, column;
+
+    // Whole input, either mmapped or read in one go, or the window over a
+    // streamed one. A window keeps the lexeme being read and whatever was
+    // read past it.
+    char *source;
+    size_t source_size;
+    bool is_mapped;
+
+    bool is_streaming;
+    bool is_input_done;
+    int fd;
+    size_t allocated;
+
+    char *curr;
+    char *end;
+    // Index just past the last line break in a streamed window, 0 if none.
+    // No token spans a line, so any token before it is whole.
+    size_t line_end;
+
+    SourceFile *file;
+    // Offset in the file of source[0], only moves for streamed input
+    size_t offset;
+
+    // Offset of the token the parser is at when it runs on another thread,
+    // streamed text past it is still needed for its diagnostics
+    atomic_uint *parsed;
+    // Queue of the lexer thread, flushed before reading more input, which
+    // may block, so the parser has every whole line that arrived
+    SpscQueue *pipeline_tokens;
+
     bool error;
+    // Set errors without reporting them
+    bool is_quiet;
 } Lexer;
 
-extern Lexer *lexer;
+// Runs the lexer on its own thread, ahead of the parser
+typedef struct LexerPipeline {
+    pthread_t thread;
+    Lexer *lexer;
+    SpscQueue tokens;
+    atomic_uint parsed;
+
+    // Consumer side, the TT_EOF token is repeated once received
+    bool is_done;
+    Token eof;
+} LexerPipeline;
 
+// Thread local, so chunks of the input can be lexed side by side
+extern _Thread_local Lexer *lexer;
+
+// "-" reads from stdin
 bool lexer_init(char *input_path);
+// Takes over fd, input_path is only used to report locations
+bool lexer_init_fd(int fd, char *input_path);
 void lexer_deinit();
 
+void lexer_scan(Token *result);
 Token *lexer_next();
+// Lexes the rest of the input into buffer, up to and including TT_EOF
+void lexer_tokenize(TokenBuffer *buffer);
+// Same result as lexer_tokenize, lexing chunks of the input on up to jobs
+// threads
+void lexer_tokenize_parallel(TokenBuffer *buffer, size_t jobs);
+
+bool lexer_pipeline_start(LexerPipeline *pipeline);
+void lexer_pipeline_next(LexerPipeline *pipeline, Token *dest);
+void lexer_pipeline_stop(LexerPipeline *pipeline);
 
 #endif
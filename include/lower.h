@@ -0,0 +1,19 @@
+#ifndef C0_LOWER_H
+#define C0_LOWER_H
+
+#include "./ast_buffer.h"
+
+// Rewrites every access path in fun, a variable followed by field, element
+// and dereference steps, into a single ET_PATH. Fields are resolved to their
+// offsets and constant offsets and indices are folded into one displacement.
+// Returns false if any path is ill-typed.
+//
+// A local array of structs whose elements are only ever used to reach one
+// of their fields is split: stored as one array per field, so a loop over
+// a field reads just that field's values. Which arrays are split is read
+// from tree, fun in compact form.
+bool lower_function(Function *fun, AstBuffer *tree);
+
+extern bool lower_split_arrays;
+
+#endif
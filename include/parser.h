@@ -8,28 +8,35 @@
 
 #define PARSER_LOOK_AHEAD 3
 
+// Tokens handed out in buffered mode live in a ring of this many slots,
+// so a Token * stays valid for the next PARSER_TOKEN_WINDOW - 1 reads
+#define PARSER_TOKEN_WINDOW 16
+
 typedef struct Parser {
     Lexer *lexer;
     bool error;
 
-    bool is_tracking;
-    size_t oldest_state;
     size_t curr_token;
     CyclicQueue tokens;
+
+    // Pre-tokenized input, NULL when tokens are lexed on demand.
+    // When set, curr_token is an index into it.
+    TokenBuffer *buffer;
+    Token window[PARSER_TOKEN_WINDOW];
+
+    // Lexer thread to pull tokens from, NULL to call the lexer directly
+    LexerPipeline *pipeline;
 } Parser;
 
 extern Parser *parser;
 
-void parser_init();
+void parser_init(TokenBuffer *buffer, LexerPipeline *pipeline);
 void parser_deinit();
 
 Expr *parser_id();
-Expr *parser_f();
-Expr *parser_t();
+// Arithmetic and boolean expressions are read by one precedence climbing
+// parser, without going back over any token
 Expr *parser_e();
-
-Expr *parser_bf();
-Expr *parser_bt();
 Expr *parser_be();
 
 Stmt *parser_stmt();
@@ -41,5 +48,8 @@ bool parser_tyds();
 bool parser_global_vad();
 
 Function *parser_fud();
+// Type definitions, global variables, then a function. NULL when there
+// is no function, as well as on errors.
+Function *parser_prog();
 
 #endif
@@ -0,0 +1,37 @@
+#ifndef C0_SCAN_H
+#define C0_SCAN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SCAN_ALPHA   0x1
+#define SCAN_DIGIT   0x2
+#define SCAN_WORD    0x4 // alpha, digit or '_'
+#define SCAN_BLANK   0x8 // ' ', '\t', '\r' or '\n'
+#define SCAN_NEWLINE 0x10
+
+#define scan_is(_c, _class) (scan_classes[(unsigned char) (_c)] & (_class))
+
+extern const unsigned char scan_classes[256];
+
+// Each scanner returns the first character in [curr, end) past its lexeme.
+// Words and numbers are hashed (see str_hash_word) as they are scanned.
+extern char *(*scan_word)(char *curr, char *end, size_t *hash);
+// Lines are found only when a diagnostic needs them, see source.h
+extern char *(*scan_blanks)(char *curr, char *end);
+
+// Digits with an optional 'u' suffix, value accumulated like strtol
+char *scan_number(char *curr, char *end, long *value, size_t *hash);
+
+typedef enum ScanLevel {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2
+} ScanLevel;
+
+// Picks the SSE2 kernels, or the scalar ones if the CPU lacks SSE2
+void scan_init();
+// Picks the kernels of level, false if the CPU cannot run them
+bool scan_use(ScanLevel level);
+
+#endif
@@ -2,24 +2,68 @@
 #define C0_STR_H
 
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
 
-#define STRING_BUCKETS_SIZE 1024
+#define STR_SHARDS 64 // Always power of 2
+#define STR_TABLE_INITIAL_SIZE 64 // Per shard, always power of 2
+#define STR_ARENA_BLOCK_SIZE (16 * 1024)
+// Entries live in segments that never move, each twice the size of the
+// one before it
+#define STR_ENTRY_SEGMENT_SIZE 1024
+#define STR_ENTRY_SEGMENTS 32
 
-#define str_len(_str) (((String*)(_str))->size)
+#define STR_HASH_SEED 0x9e3779b97f4a7c15ull
 
-typedef struct String String;
+// Interned strings are stored right after their 32-bit length
+#define str_len(_str) (((uint32_t *) (_str))[-1])
 
-struct String {
-    char *str;
-    size_t len;
-    String *next;
-};
+// Dense, handed out in interning order starting from 0
+typedef uint32_t StrId;
 
-extern String *strings[STRING_BUCKETS_SIZE];
+// Never handed out
+#define STR_NONE UINT32_MAX
 
-char *str_get(char *str, size_t len);
-char *str_get_null_term(char *str);
+// The hash consumes the string as little-endian 8-byte words, the last 
+// one zero padded, and then its length. This lets the lexer hash a 
+// lexeme while scanning it and hand the result to str_intern_hashed.
+static inline size_t str_hash_word(size_t hash, uint64_t word)
+{
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    return hash ^ (hash >> 32);
+}
+
+static inline size_t str_hash_finish(size_t hash, size_t len)
+{
+    return str_hash_word(hash, len);
+}
+
+// Interning and str_chars are safe from any number of threads. IDs and the
+// strings behind them never move until str_deinit.
+
+// Interns reserved[i] as ID i
+void str_init(char **reserved, size_t count);
+void str_deinit();
+
+StrId str_intern(char *str, size_t len);
+StrId str_intern_hashed(char *str, size_t len, size_t hash);
+StrId str_intern_null_term(char *str);
+
+// Null terminated, with str_len working on it
+char *str_chars(StrId id);
+
+// Bytes the interner holds, allocated but unused space included
+typedef struct StrStats {
+    size_t count;
+    size_t table_bytes; // Current tables of the shards
+    size_t retired_bytes; // Tables replaced by bigger ones
+    size_t string_bytes; // Blocks holding the strings themselves
+    size_t entry_bytes; // Segments of the ID to string array
+} StrStats;
+
+void str_stats(StrStats *stats);
 
 size_t str_hash(char *str);
+size_t str_hash_len(char *str, size_t len);
 
 #endif
@@ -4,7 +4,7 @@
 #include "./utils.h"
 #include "./type.h"
 
-#define SYMTABLE_SIZE 128 // Always power of 2
+#define SYMBOL_BLOCK_SIZE 256
 
 typedef enum SymScope {
     SS_LABEL,
@@ -18,38 +18,62 @@ typedef struct SymTable SymTable;
 typedef struct Function Function;
 
 struct Symbol {
-    char *name;
+    StrId name;
     Type *type;
     Function *function;
     SymScope scope;
     Location loc;
 
-    Symbol *next;
+    // An array of structs stored as one array per field, see lower.h
+    bool is_split;
+
+    // Scope nesting depth it was added at, and the binding of the same
+    // name it hides until that scope is left
+    size_t depth;
+    Symbol *shadowed;
 };
 
+// One flat map from name to its innermost binding, so a lookup is a single
+// load however deep the scopes go. Entering a scope only marks the undo 
+// log, leaving it unbinds everything added since.
 struct SymTable {
-    Symbol *symbols[SYMTABLE_SIZE];
-    SymTable *prev;
+    Symbol **bindings; // Indexed by name
+    size_t bindings_allocated;
+
+    Symbol **log;
+    size_t log_size;
+    size_t log_allocated;
+
+    size_t *scopes; // Log size when each open scope was entered
+    size_t depth;
+    size_t scopes_allocated;
 };
 
 extern SymTable *global_syms;
 extern SymTable *function_syms;
 
-Symbol *symbol_create(char *name, 
+// Symbols come from a pool freed by symtable_deinit
+Symbol *symbol_create(StrId name, 
                       Type *type, 
                       SymScope scope, 
                       Location *loc_src);
-Symbol *function_symbol_create(char *name, 
+Symbol *function_symbol_create(StrId name, 
                                Function *function, 
                                Location *loc_src);
 
 void symtable_init();
 void symtable_deinit();
 
-SymTable *symtable_create(SymTable *prev);
+SymTable *symtable_create();
 void symtable_destroy(SymTable *table);
 
+void symtable_enter(SymTable *table);
+// Returns the symbols of the scope in the order they were added, in a new
+// array, if count is not NULL
+Symbol **symtable_leave(SymTable *table, size_t *count);
+
+// Fails if name is already bound in the current scope
 bool symtable_add(SymTable *table, Symbol *sym);
-Symbol *symtable_get(SymTable *table, char *name);
+Symbol *symtable_get(SymTable *table, StrId name);
 
 #endif
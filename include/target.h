@@ -0,0 +1,31 @@
+#ifndef C0_TARGET_H
+#define C0_TARGET_H
+
+#include "./utils.h"
+
+// int, bool, char, uint and pointer, in TypeOp order
+#define TARGET_SCALAR_COUNT 5
+
+// Data layout of a machine code is generated for
+typedef struct Target {
+    char *name;
+
+    size_t sizes[TARGET_SCALAR_COUNT];
+    size_t aligns[TARGET_SCALAR_COUNT];
+
+    size_t stack_align;
+    // Widest register worth using to move data, in bytes: a vector register,
+    // or a word on machines without them
+    size_t vector_width;
+} Target;
+
+extern const Target target_x86;
+extern const Target target_x86_64;
+extern const Target target_dlx;
+
+extern const Target *target_default;
+
+// NULL if there is no target called name
+const Target *target_find(char *name);
+
+#endif
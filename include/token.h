@@ -67,17 +67,24 @@ typedef union TokenValue {
 typedef struct Token {
     TokenType type;
     Location loc;
-    char *lexeme;
+    StrId lexeme;
 
     bool is_null;
     TokenValue value_as;
 } Token;
 
+// Interned first, so the ID of token_strings[type] is type
 extern char *token_strings[];
 
+void token_init(Token *token, TokenType type, Location *loc_src);
+void token_init_with_lexeme(Token *token, TokenType type, 
+                            Location *loc_src, StrId lexeme);
+
 Token *token_create(TokenType type, Location *loc_src);
-Token *token_create_with_lexeme(TokenType type, Location *loc_src, char *lexeme);
+Token *token_create_with_lexeme(TokenType type, Location *loc_src, StrId lexeme);
 
 void token_destroy(Token *token);
 
+TokenType token_keyword(char *str, size_t len);
+
 #endif
@@ -0,0 +1,27 @@
+#ifndef C0_TOKEN_BUFFER_H
+#define C0_TOKEN_BUFFER_H
+
+#include <stdint.h>
+#include "./token.h"
+
+// Whole translation unit as parallel arrays, one entry per token.
+// The last token is always TT_EOF.
+typedef struct TokenBuffer {
+    size_t size;
+    size_t allocated;
+
+    unsigned char *types;
+    StrId *lexemes;
+    TokenValue *values;
+    Location *locs;
+} TokenBuffer;
+
+void token_buffer_create(TokenBuffer *buffer, size_t initial_size);
+void token_buffer_destroy(TokenBuffer *buffer);
+
+void token_buffer_push(TokenBuffer *buffer, Token *token);
+void token_buffer_append(TokenBuffer *buffer, TokenBuffer *other);
+// Indices past the end read the final TT_EOF
+void token_buffer_get(TokenBuffer *buffer, size_t index, Token *dest);
+
+#endif
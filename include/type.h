@@ -2,6 +2,11 @@
 #define C0_TYPE_H
 
 #include "./utils.h"
+#include "./target.h"
+
+#define TYPE_BLOCK_SIZE 256
+#define TYPE_ARRAYS_INITIAL_SIZE 64 // Always power of 2
+#define TYPE_CACHE_LINE_SIZE 64
 
 typedef enum TypeOp {
     TO_INT = 0,
@@ -17,23 +22,32 @@ typedef struct Type Type;
 typedef struct Field Field;
 
 struct Field {
-    char *name;
+    StrId name;
     Type *type;
     size_t offset;
 };
 
 struct Type {
-    char *name;
+    size_t id; // Types are numbered in the order they are made
+    StrId name; // First name it was given, STR_NONE if it has none
     Type *child;
     size_t size;
     size_t align;
     TypeOp op;
     bool is_defined;
 
+    size_t elements; // Arrays only
+
     size_t fields_count;
-    Field *fields;
+    Field *fields; // In layout order
+    size_t declared_size; // Structs only, with fields in declaration order
 
-    Type *next;
+    // Pointer and array types are hash-consed: structurally equal ones are
+    // the same Type, pointers through the pointee's cached pointer field
+    Type *pointer;
+    // Only set on a forward declared type that was then defined as a
+    // pointer or array type that already existed, which it stands in for
+    Type *canonical;
 };
 
 extern Type *type_int;
@@ -41,14 +55,55 @@ extern Type *type_bool;
 extern Type *type_char;
 extern Type *type_uint;
 
-void type_init();
+// The target types are laid out for
+extern const Target *type_target;
+// Lay struct fields out by decreasing alignment, to cut padding
+extern bool type_reorder_fields;
+
+void type_init(const Target *target);
 void type_deinit();
 
-Type *type_add(char *name);
-Type *type_get(char *name);
+static inline Type *type_canonical(Type *type)
+{
+    return type->canonical != NULL ? type->canonical : type;
+}
+
+// Forward declares name
+Type *type_add(StrId name);
+Type *type_get(StrId name);
+
+// Unnamed, structurally equal results are equal pointers
+Type *type_pointer_to(Type *child);
+Type *type_array_of(Type *child, size_t elements);
+
+// The named versions return NULL if name is already defined
+Type *type_pointer(StrId name, Type *child);
+Type *type_array(StrId name, Type *child, size_t elements);
+Type *type_struct(StrId name, Field *fields, size_t fields_count);
+// Keeps the struct called name in declaration order even when reordering
+void type_keep_layout(StrId name);
+bool type_is_layout_kept(StrId name);
+// Every name passed to type_keep_layout
+StrId *type_layouts_kept(size_t *count);
+// Where the array of field's values starts, when an array of structs is
+// stored as one array per field, in field order
+size_t type_split_offset(Type *array, Field *field);
+size_t type_split_size(Type *array);
+// Size, padding and fields crossing a cache line of every struct
+void type_layout_report(FILE *out);
+
+// For interface files, which save and restore whole type tables.
+// Types are listed by id, and every name bound to a type is below
+// type_names_end. A type read back is made with type_new,
+// filled in as it was, and then entered into the tables that hash-cons 
+// pointer and array types and list structs.
+Type **type_list(size_t *count);
+StrId type_names_end();
+Type *type_new(StrId name);
+void type_name(StrId name, Type *type);
+void type_enter(Type *type);
 
-Type *type_pointer(char *name, Type *child);
-Type *type_array(char *name, Type *child, size_t elements);
-Type *type_struct(char *name, Field *fields, size_t fields_count);
+// NULL if the struct has no such field
+Field *type_field(Type *type, StrId name);
 
 #endif
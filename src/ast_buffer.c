@@ -0,0 +1,497 @@
+#include "../include/ast_buffer.h"
+
+void ast_buffer_create(AstBuffer *buffer, size_t initial_size)
+{
+    buffer->size = 0;
+    buffer->allocated = initial_size > 0 ? initial_size : 1;
+
+    buffer->kinds = malloc(buffer->allocated * sizeof *buffer->kinds);
+    buffer->ops = malloc(buffer->allocated * sizeof *buffer->ops);
+    buffer->lhs = malloc(buffer->allocated * sizeof *buffer->lhs);
+    buffer->rhs = malloc(buffer->allocated * sizeof *buffer->rhs);
+    buffer->locs = malloc(buffer->allocated * sizeof *buffer->locs);
+
+    buffer->lists = NULL;
+    buffer->lists_size = 0;
+    buffer->lists_allocated = 0;
+
+    buffer->syms = NULL;
+    buffer->syms_size = 0;
+    buffer->syms_allocated = 0;
+
+    buffer->sym_slots = NULL;
+    buffer->sym_slots_allocated = 0;
+
+    buffer->has_path = false;
+}
+
+void ast_buffer_destroy(AstBuffer *buffer)
+{
+    free(buffer->kinds);
+    free(buffer->ops);
+    free(buffer->lhs);
+    free(buffer->rhs);
+    free(buffer->locs);
+    free(buffer->lists);
+    free(buffer->syms);
+    free(buffer->sym_slots);
+}
+
+static void ast_buffer_resize(AstBuffer *buffer, size_t new_size)
+{
+    buffer->kinds = realloc(buffer->kinds, new_size * sizeof *buffer->kinds);
+    buffer->ops = realloc(buffer->ops, new_size * sizeof *buffer->ops);
+    buffer->lhs = realloc(buffer->lhs, new_size * sizeof *buffer->lhs);
+    buffer->rhs = realloc(buffer->rhs, new_size * sizeof *buffer->rhs);
+    buffer->locs = realloc(buffer->locs, new_size * sizeof *buffer->locs);
+    buffer->allocated = new_size;
+}
+
+static AstNode ast_buffer_push(AstBuffer *buffer, unsigned char kind, 
+                               unsigned char op, AstNode lhs, AstNode rhs, 
+                               Location *loc)
+{
+    if (buffer->size == buffer->allocated)
+        ast_buffer_resize(buffer, buffer->allocated * 2);
+
+    size_t i = buffer->size++;
+    buffer->kinds[i] = kind;
+    buffer->ops[i] = op;
+    buffer->lhs[i] = lhs;
+    buffer->rhs[i] = rhs;
+
+    buffer->locs[i] = loc != NULL ? *loc : (Location) {0};
+
+    return i;
+}
+
+// Room for count list entries, filled in by the caller
+static size_t ast_buffer_reserve(AstBuffer *buffer, size_t count)
+{
+    size_t offset = buffer->lists_size;
+    buffer->lists_size += count;
+
+    if (buffer->lists_size > buffer->lists_allocated) {
+        buffer->lists_allocated = buffer->lists_allocated == 0 
+            ? 64 : buffer->lists_allocated;
+        while (buffer->lists_allocated < buffer->lists_size)
+            buffer->lists_allocated *= 2;
+
+        buffer->lists = realloc(buffer->lists, buffer->lists_allocated 
+                                * sizeof *buffer->lists);
+    }
+
+    return offset;
+}
+
+static size_t ast_buffer_sym_hash(Symbol *sym)
+{
+    return ((uintptr_t) sym >> 4) * 0x9e3779b97f4a7c15u;
+}
+
+// Kept at most half full
+static void ast_buffer_sym_slots_grow(AstBuffer *buffer)
+{
+    size_t allocated = buffer->sym_slots_allocated == 0 
+        ? 64 : buffer->sym_slots_allocated * 2;
+    size_t mask = allocated - 1;
+
+    free(buffer->sym_slots);
+    buffer->sym_slots = malloc(allocated * sizeof *buffer->sym_slots);
+    buffer->sym_slots_allocated = allocated;
+    for (size_t i = 0; i < allocated; i++)
+        buffer->sym_slots[i] = AST_NONE;
+
+    for (size_t sym = 0; sym < buffer->syms_size; sym++) {
+        size_t i = ast_buffer_sym_hash(buffer->syms[sym]) & mask;
+        while (buffer->sym_slots[i] != AST_NONE)
+            i = (i + 1) & mask;
+
+        buffer->sym_slots[i] = sym;
+    }
+}
+
+static AstNode ast_buffer_sym(AstBuffer *buffer, Symbol *sym)
+{
+    if (sym == NULL)
+        return AST_NONE;
+
+    if (2 * (buffer->syms_size + 1) > buffer->sym_slots_allocated)
+        ast_buffer_sym_slots_grow(buffer);
+
+    size_t mask = buffer->sym_slots_allocated - 1;
+    size_t i = ast_buffer_sym_hash(sym) & mask;
+    for (; buffer->sym_slots[i] != AST_NONE; i = (i + 1) & mask) {
+        if (buffer->syms[buffer->sym_slots[i]] == sym)
+            return buffer->sym_slots[i];
+    }
+
+    if (buffer->syms_size == buffer->syms_allocated) {
+        buffer->syms_allocated = buffer->syms_allocated == 0 
+            ? 64 : buffer->syms_allocated * 2;
+        buffer->syms = realloc(buffer->syms, buffer->syms_allocated 
+                               * sizeof *buffer->syms);
+    }
+
+    buffer->syms[buffer->syms_size] = sym;
+    buffer->sym_slots[i] = buffer->syms_size;
+    return buffer->syms_size++;
+}
+
+static AstNode ast_buffer_push_expr(AstBuffer *buffer, Expr *e)
+{
+    AstNode lhs = 0;
+    AstNode rhs = 0;
+    unsigned char op = 0;
+
+    switch (e->type) {
+    case ET_BINARY:
+        lhs = ast_buffer_push_expr(buffer, e->as.binary.left);
+        rhs = ast_buffer_push_expr(buffer, e->as.binary.right);
+        op = e->as.binary.op;
+        break;
+
+    case ET_UNARY:
+        lhs = ast_buffer_push_expr(buffer, e->as.unary.e);
+        op = e->as.unary.op;
+        break;
+
+    case ET_ACCESS:
+        lhs = ast_buffer_push_expr(buffer, e->as.access.left);
+        rhs = e->as.access.na;
+        break;
+
+    case ET_ARR_ACCESS:
+        lhs = ast_buffer_push_expr(buffer, e->as.arr_access.left);
+        rhs = ast_buffer_push_expr(buffer, e->as.arr_access.index);
+        break;
+
+    case ET_C:
+        lhs = (uint64_t) e->as.c;
+        rhs = (uint64_t) e->as.c >> 32;
+        break;
+
+    case ET_BC:
+        lhs = e->as.bc;
+        break;
+
+    case ET_CC:
+        lhs = (unsigned char) e->as.cc;
+        break;
+
+    case ET_NA:
+        lhs = e->as.na.name;
+        rhs = ast_buffer_sym(buffer, e->as.na.sym);
+        break;
+
+    case ET_NULL:
+        break;
+
+    case ET_PATH:
+        // The whole tree is dropped once it is added
+        buffer->has_path = true;
+        break;
+    }
+
+    return ast_buffer_push(buffer, e->type, op, lhs, rhs, &e->loc);
+}
+
+static AstNode ast_buffer_push_stmt(AstBuffer *buffer, Stmt *stmt);
+
+static AstNode ast_buffer_push_stmts(AstBuffer *buffer, Stmt **stmts)
+{
+    if (stmts == NULL)
+        return AST_NONE;
+
+    size_t count = 0;
+    while (stmts[count] != NULL)
+        count++;
+
+    size_t offset = ast_buffer_reserve(buffer, count);
+    for (size_t i = 0; i < count; i++) {
+        AstNode stmt = ast_buffer_push_stmt(buffer, stmts[i]);
+        buffer->lists[offset + i] = stmt;
+    }
+
+    return ast_buffer_push(buffer, AK_LIST, 0, offset, count, NULL);
+}
+
+static AstNode ast_buffer_push_stmt(AstBuffer *buffer, Stmt *stmt)
+{
+    AstNode lhs = 0;
+    AstNode rhs = 0;
+
+    switch (stmt->type) {
+    case ST_ASSIGN:
+        lhs = ast_buffer_push_expr(buffer, stmt->as.assign.left);
+        rhs = ast_buffer_push_expr(buffer, stmt->as.assign.right);
+        break;
+
+    case ST_IF:
+        {
+            lhs = ast_buffer_push_expr(buffer, stmt->as.if_stmt.cond);
+
+            AstNode then_block = 
+                ast_buffer_push_stmts(buffer, stmt->as.if_stmt.then_block);
+            AstNode else_block = 
+                ast_buffer_push_stmts(buffer, stmt->as.if_stmt.else_block);
+
+            size_t count = else_block == AST_NONE ? 1 : 2;
+            size_t offset = ast_buffer_reserve(buffer, count);
+            buffer->lists[offset] = then_block;
+            if (count == 2)
+                buffer->lists[offset + 1] = else_block;
+
+            rhs = ast_buffer_push(buffer, AK_LIST, 0, offset, count, NULL);
+        }
+        break;
+
+    case ST_WHILE:
+        lhs = ast_buffer_push_expr(buffer, stmt->as.while_stmt.cond);
+        rhs = ast_buffer_push_stmts(buffer, stmt->as.while_stmt.block);
+        break;
+
+    case ST_FUNCALL:
+        {
+            lhs = ast_buffer_push_expr(buffer, stmt->as.funcall.left);
+
+            AstNode sym = ast_buffer_sym(buffer, stmt->as.funcall.sym);
+            AstNode callee = ast_buffer_push(buffer, ET_NA, 0, 
+                                             stmt->as.funcall.na, sym, 
+                                             &stmt->loc);
+
+            Expr **args = stmt->as.funcall.args;
+            size_t count = 0;
+            while (args != NULL && args[count] != NULL)
+                count++;
+
+            size_t offset = ast_buffer_reserve(buffer, count + 1);
+            buffer->lists[offset] = callee;
+            for (size_t i = 0; i < count; i++) {
+                AstNode arg = ast_buffer_push_expr(buffer, args[i]);
+                buffer->lists[offset + 1 + i] = arg;
+            }
+
+            rhs = ast_buffer_push(buffer, AK_LIST, 0, offset, count + 1, NULL);
+        }
+        break;
+
+    case ST_NEW:
+        lhs = ast_buffer_push_expr(buffer, stmt->as.new_stmt.left);
+        rhs = stmt->as.new_stmt.na;
+        break;
+
+    case ST_RETURN:
+        lhs = ast_buffer_push_expr(buffer, stmt->as.return_stmt);
+        break;
+    }
+
+    return ast_buffer_push(buffer, AK_STMT + stmt->type, 0, lhs, rhs, 
+                           &stmt->loc);
+}
+
+// Drops the nodes and lists added since size and lists_size if they
+// include a lowered path. Symbols stay, each is still in syms once.
+static AstNode ast_buffer_finish(AstBuffer *buffer, size_t size, 
+                                 size_t lists_size, AstNode node)
+{
+    if (!buffer->has_path)
+        return node;
+
+    buffer->size = size;
+    buffer->lists_size = lists_size;
+    buffer->has_path = false;
+    return AST_NONE;
+}
+
+AstNode ast_buffer_add_expr(AstBuffer *buffer, Expr *e)
+{
+    size_t size = buffer->size;
+    size_t lists_size = buffer->lists_size;
+    AstNode node = ast_buffer_push_expr(buffer, e);
+
+    return ast_buffer_finish(buffer, size, lists_size, node);
+}
+
+AstNode ast_buffer_add_stmt(AstBuffer *buffer, Stmt *stmt)
+{
+    size_t size = buffer->size;
+    size_t lists_size = buffer->lists_size;
+    AstNode node = ast_buffer_push_stmt(buffer, stmt);
+
+    return ast_buffer_finish(buffer, size, lists_size, node);
+}
+
+AstNode ast_buffer_add_stmts(AstBuffer *buffer, Stmt **stmts)
+{
+    size_t size = buffer->size;
+    size_t lists_size = buffer->lists_size;
+    AstNode node = ast_buffer_push_stmts(buffer, stmts);
+
+    return ast_buffer_finish(buffer, size, lists_size, node);
+}
+
+AstNode ast_buffer_add_function(AstBuffer *buffer, Function *fun)
+{
+    size_t size = buffer->size;
+    size_t lists_size = buffer->lists_size;
+
+    size_t count = 0;
+    while (fun->stmts != NULL && fun->stmts[count] != NULL)
+        count++;
+
+    size_t offset = ast_buffer_reserve(buffer, count + 1);
+    for (size_t i = 0; i < count; i++) {
+        AstNode stmt = ast_buffer_push_stmt(buffer, fun->stmts[i]);
+        buffer->lists[offset + i] = stmt;
+    }
+    AstNode return_stmt = ast_buffer_push_stmt(buffer, fun->return_stmt);
+    buffer->lists[offset + count] = return_stmt;
+
+    AstNode node = ast_buffer_push(buffer, AK_LIST, 0, offset, count + 1, 
+                                   NULL);
+    return ast_buffer_finish(buffer, size, lists_size, node);
+}
+
+static Symbol *ast_buffer_get_sym(AstBuffer *buffer, AstNode sym)
+{
+    return sym == AST_NONE ? NULL : buffer->syms[sym];
+}
+
+Expr *ast_buffer_expr(AstBuffer *buffer, AstNode node)
+{
+    Expr *result = ast_alloc(sizeof *result);
+    result->type = buffer->kinds[node];
+    result->loc = buffer->locs[node];
+
+    AstNode lhs = buffer->lhs[node];
+    AstNode rhs = buffer->rhs[node];
+
+    switch (result->type) {
+    case ET_BINARY:
+        result->as.binary.op = buffer->ops[node];
+        result->as.binary.left = ast_buffer_expr(buffer, lhs);
+        result->as.binary.right = ast_buffer_expr(buffer, rhs);
+        break;
+
+    case ET_UNARY:
+        result->as.unary.op = buffer->ops[node];
+        result->as.unary.e = ast_buffer_expr(buffer, lhs);
+        break;
+
+    case ET_ACCESS:
+        result->as.access.left = ast_buffer_expr(buffer, lhs);
+        result->as.access.na = rhs;
+        break;
+
+    case ET_ARR_ACCESS:
+        result->as.arr_access.left = ast_buffer_expr(buffer, lhs);
+        result->as.arr_access.index = ast_buffer_expr(buffer, rhs);
+        break;
+
+    case ET_C:
+        result->as.c = (long) ((uint64_t) rhs << 32 | lhs);
+        break;
+
+    case ET_BC:
+        result->as.bc = lhs;
+        break;
+
+    case ET_CC:
+        result->as.cc = lhs;
+        break;
+
+    case ET_NA:
+        result->as.na.name = lhs;
+        result->as.na.sym = ast_buffer_get_sym(buffer, rhs);
+        break;
+
+    default:
+        break;
+    }
+
+    return result;
+}
+
+Stmt **ast_buffer_stmts(AstBuffer *buffer, AstNode list)
+{
+    if (list == AST_NONE)
+        return NULL;
+
+    AstNode *stmts = buffer->lists + buffer->lhs[list];
+    size_t count = buffer->rhs[list];
+
+    Stmt **result = ast_alloc((count + 1) * sizeof *result);
+    for (size_t i = 0; i < count; i++)
+        result[i] = ast_buffer_stmt(buffer, stmts[i]);
+    result[count] = NULL;
+
+    return result;
+}
+
+Stmt *ast_buffer_stmt(AstBuffer *buffer, AstNode node)
+{
+    Stmt *result = ast_alloc(sizeof *result);
+    result->type = buffer->kinds[node] - AK_STMT;
+    result->loc = buffer->locs[node];
+
+    AstNode lhs = buffer->lhs[node];
+    AstNode rhs = buffer->rhs[node];
+
+    switch (result->type) {
+    case ST_ASSIGN:
+        result->as.assign.left = ast_buffer_expr(buffer, lhs);
+        result->as.assign.right = ast_buffer_expr(buffer, rhs);
+        break;
+
+    case ST_IF:
+        {
+            AstNode *blocks = buffer->lists + buffer->lhs[rhs];
+            bool has_else = buffer->rhs[rhs] == 2;
+
+            result->as.if_stmt.cond = ast_buffer_expr(buffer, lhs);
+            result->as.if_stmt.then_block = 
+                ast_buffer_stmts(buffer, blocks[0]);
+            result->as.if_stmt.else_block = 
+                has_else ? ast_buffer_stmts(buffer, blocks[1]) : NULL;
+        }
+        break;
+
+    case ST_WHILE:
+        result->as.while_stmt.cond = ast_buffer_expr(buffer, lhs);
+        result->as.while_stmt.block = ast_buffer_stmts(buffer, rhs);
+        break;
+
+    case ST_FUNCALL:
+        {
+            AstNode *list = buffer->lists + buffer->lhs[rhs];
+            size_t count = buffer->rhs[rhs] - 1;
+
+            result->as.funcall.left = ast_buffer_expr(buffer, lhs);
+            result->as.funcall.na = buffer->lhs[list[0]];
+            result->as.funcall.sym = 
+                ast_buffer_get_sym(buffer, buffer->rhs[list[0]]);
+
+            Expr **args = NULL;
+            if (count > 0) {
+                args = ast_alloc((count + 1) * sizeof *args);
+                for (size_t i = 0; i < count; i++)
+                    args[i] = ast_buffer_expr(buffer, list[1 + i]);
+                args[count] = NULL;
+            }
+            result->as.funcall.args = args;
+        }
+        break;
+
+    case ST_NEW:
+        result->as.new_stmt.left = ast_buffer_expr(buffer, lhs);
+        result->as.new_stmt.na = rhs;
+        break;
+
+    case ST_RETURN:
+        result->as.return_stmt = ast_buffer_expr(buffer, lhs);
+        break;
+    }
+
+    return result;
+}
@@ -0,0 +1,90 @@
+#include <string.h>
+#include "../../include/data_structures/arena.h"
+
+static size_t arena_round(size_t size)
+{
+    return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static void arena_use(Arena *arena, ArenaBlock *block)
+{
+    arena->curr = block->data;
+    arena->end = block->data + block->size;
+}
+
+void arena_create(Arena *arena, size_t block_size)
+{
+    arena->blocks = NULL;
+    arena->curr = NULL;
+    arena->end = NULL;
+    arena->block_size = arena_round(block_size);
+}
+
+void arena_destroy(Arena *arena)
+{
+    ArenaBlock *block = arena->blocks;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->blocks = NULL;
+    arena->curr = NULL;
+    arena->end = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = arena_round(size);
+
+    if ((size_t) (arena->end - arena->curr) < size) {
+        while (arena->block_size < size)
+            arena->block_size *= 2;
+
+        ArenaBlock *block = malloc(sizeof *block + arena->block_size);
+        block->size = arena->block_size;
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->block_size *= 2;
+        arena_use(arena, block);
+    }
+
+    void *result = arena->curr;
+    arena->curr += size;
+    return result;
+}
+
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    unsigned char *old_end = (unsigned char *) ptr + arena_round(old_size);
+    size_t grow = arena_round(new_size) - arena_round(old_size);
+
+    if (ptr != NULL && old_end == arena->curr &&
+        new_size >= old_size && (size_t) (arena->end - arena->curr) >= grow) {
+        arena->curr += grow;
+        return ptr;
+    }
+
+    void *result = arena_alloc(arena, new_size);
+    if (ptr != NULL)
+        memcpy(result, ptr, old_size < new_size ? old_size : new_size);
+
+    return result;
+}
+
+void arena_reset(Arena *arena)
+{
+    if (arena->blocks == NULL)
+        return;
+
+    ArenaBlock *block = arena->blocks->next;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->blocks->next = NULL;
+    arena_use(arena, arena->blocks);
+}
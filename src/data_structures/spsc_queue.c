@@ -0,0 +1,166 @@
+#include <sched.h>
+#include "../../include/data_structures/spsc_queue.h"
+
+void spsc_queue_create(SpscQueue *queue,
+                       size_t element_size,
+                       size_t allocated_elements)
+{
+    size_t size = SPSC_QUEUE_BATCH * 2;
+    while (size < allocated_elements)
+        size *= 2;
+
+    queue->element_size = element_size;
+    queue->allocated_elements = size;
+    queue->data = malloc(element_size * size * sizeof *queue->data);
+
+    atomic_init(&queue->closed, false);
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->wakeup, NULL);
+    atomic_init(&queue->is_producer_waiting, false);
+    atomic_init(&queue->is_consumer_waiting, false);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->head, 0);
+    queue->producer_tail = queue->producer_head = 0;
+    queue->consumer_head = queue->consumer_tail = 0;
+}
+
+void spsc_queue_destroy(SpscQueue *queue)
+{
+    pthread_cond_destroy(&queue->wakeup);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->data);
+}
+
+static inline void *spsc_queue_offset(SpscQueue *queue, size_t index)
+{
+    size_t i = index & (queue->allocated_elements - 1);
+    return queue->data + i * queue->element_size;
+}
+
+// Publishing and the waiting flags are both sequentially consistent, so
+// either the waiting side sees the new index or this side sees the flag
+static void spsc_queue_wake(SpscQueue *queue, atomic_bool *is_waiting)
+{
+    if (!atomic_load(is_waiting))
+        return;
+
+    pthread_mutex_lock(&queue->lock);
+    pthread_cond_broadcast(&queue->wakeup);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static bool spsc_queue_is_full(SpscQueue *queue)
+{
+    return queue->producer_tail - atomic_load(&queue->head)
+        == queue->allocated_elements && !atomic_load(&queue->closed);
+}
+
+static bool spsc_queue_is_empty(SpscQueue *queue)
+{
+    return atomic_load(&queue->tail) == queue->consumer_head &&
+        !atomic_load(&queue->closed);
+}
+
+static void spsc_queue_wait(SpscQueue *queue, 
+                            atomic_bool *is_waiting,
+                            bool (*must_wait)(SpscQueue *))
+{
+    pthread_mutex_lock(&queue->lock);
+    atomic_store(is_waiting, true);
+    if (must_wait(queue))
+        pthread_cond_wait(&queue->wakeup, &queue->lock);
+    atomic_store(is_waiting, false);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void spsc_queue_flush(SpscQueue *queue)
+{
+    atomic_store(&queue->tail, queue->producer_tail);
+    spsc_queue_wake(queue, &queue->is_consumer_waiting);
+}
+
+static void spsc_queue_release(SpscQueue *queue)
+{
+    atomic_store(&queue->head, queue->consumer_head);
+    spsc_queue_wake(queue, &queue->is_producer_waiting);
+}
+
+bool spsc_queue_push(SpscQueue *queue, void *element)
+{
+    if (atomic_load_explicit(&queue->closed, memory_order_relaxed))
+        return false;
+
+    size_t spins = 0;
+    while (queue->producer_tail - queue->producer_head
+           == queue->allocated_elements) {
+        queue->producer_head = atomic_load_explicit(&queue->head,
+                                                    memory_order_acquire);
+        if (queue->producer_tail - queue->producer_head
+            != queue->allocated_elements)
+            break;
+
+        if (atomic_load_explicit(&queue->closed, memory_order_relaxed))
+            return false;
+
+        spsc_queue_flush(queue);
+        if (spins++ < SPSC_QUEUE_SPINS)
+            sched_yield();
+        else
+            spsc_queue_wait(queue, &queue->is_producer_waiting, 
+                            spsc_queue_is_full);
+    }
+
+    memcpy(spsc_queue_offset(queue, queue->producer_tail),
+           element, queue->element_size);
+    queue->producer_tail++;
+
+    if (queue->producer_tail % SPSC_QUEUE_BATCH == 0)
+        spsc_queue_flush(queue);
+
+    return true;
+}
+
+bool spsc_queue_pop(SpscQueue *queue, void *dest)
+{
+    size_t spins = 0;
+    while (queue->consumer_head == queue->consumer_tail) {
+        queue->consumer_tail = atomic_load_explicit(&queue->tail,
+                                                    memory_order_acquire);
+        if (queue->consumer_head != queue->consumer_tail)
+            break;
+
+        // Closing happens after the final flush, so check the tail again
+        if (atomic_load_explicit(&queue->closed, memory_order_acquire)) {
+            queue->consumer_tail = atomic_load_explicit(&queue->tail,
+                                                        memory_order_acquire);
+            if (queue->consumer_head == queue->consumer_tail)
+                return false;
+            break;
+        }
+
+        spsc_queue_release(queue);
+        if (spins++ < SPSC_QUEUE_SPINS)
+            sched_yield();
+        else
+            spsc_queue_wait(queue, &queue->is_consumer_waiting, 
+                            spsc_queue_is_empty);
+    }
+
+    memcpy(dest, spsc_queue_offset(queue, queue->consumer_head),
+           queue->element_size);
+    queue->consumer_head++;
+
+    if (queue->consumer_head % SPSC_QUEUE_BATCH == 0)
+        spsc_queue_release(queue);
+
+    return true;
+}
+
+void spsc_queue_close(SpscQueue *queue)
+{
+    atomic_store(&queue->closed, true);
+
+    pthread_mutex_lock(&queue->lock);
+    pthread_cond_broadcast(&queue->wakeup);
+    pthread_mutex_unlock(&queue->lock);
+}
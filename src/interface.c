@@ -0,0 +1,536 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/interface.h"
+
+typedef struct InterfaceWriter {
+    uint32_t *string_of; // Indexed by StrId
+    size_t string_of_allocated;
+
+    uint32_t *strings;
+    size_t strings_count, strings_allocated;
+
+    char *chars;
+    size_t chars_size, chars_allocated;
+} InterfaceWriter;
+
+static void *interface_grow(void *array, size_t *allocated,
+                            size_t needed, size_t size)
+{
+    if (needed <= *allocated)
+        return array;
+
+    size_t new_allocated = *allocated == 0 ? 64 : *allocated;
+    while (new_allocated < needed)
+        new_allocated *= 2;
+
+    *allocated = new_allocated;
+    return realloc(array, new_allocated * size);
+}
+
+static uint32_t interface_string(InterfaceWriter *writer, StrId id)
+{
+    if (id == STR_NONE)
+        return INTERFACE_NONE;
+
+    if (id >= writer->string_of_allocated) {
+        size_t old = writer->string_of_allocated;
+        writer->string_of = interface_grow(writer->string_of,
+                                           &writer->string_of_allocated,
+                                           id + 1, sizeof(uint32_t));
+        memset(writer->string_of + old, 0xff,
+               (writer->string_of_allocated - old) * sizeof(uint32_t));
+    }
+
+    if (writer->string_of[id] != INTERFACE_NONE)
+        return writer->string_of[id];
+
+    char *chars = str_chars(id);
+    size_t len = str_len(chars);
+
+    writer->chars = interface_grow(writer->chars, &writer->chars_allocated,
+                                   writer->chars_size + len + 1, 1);
+    memcpy(writer->chars + writer->chars_size, chars, len + 1);
+
+    writer->strings = interface_grow(writer->strings,
+                                     &writer->strings_allocated,
+                                     writer->strings_count + 1,
+                                     sizeof(uint32_t));
+    writer->strings[writer->strings_count] = writer->chars_size;
+    writer->chars_size += len + 1;
+
+    writer->string_of[id] = writer->strings_count;
+    return writer->strings_count++;
+}
+
+static uint32_t interface_type_id(Type *type)
+{
+    return type == NULL ? INTERFACE_NONE : type->id;
+}
+
+// Sections start 8 byte aligned
+static uint64_t interface_section(uint64_t *offset, size_t size)
+{
+    uint64_t result = (*offset + 7) & ~(uint64_t) 7;
+    *offset = result + size;
+    return result;
+}
+
+static void interface_write(FILE *file, uint64_t offset,
+                            void *data, size_t size)
+{
+    static const char zeros[8];
+    fwrite(zeros, 1, offset - ftell(file), file);
+    fwrite(data, 1, size, file);
+}
+
+bool interface_emit(char *path)
+{
+    InterfaceWriter writer = { 0 };
+    InterfaceHeader header = { 0 };
+
+    size_t types_count;
+    Type **types = type_list(&types_count);
+
+    InterfaceType *type_records = calloc(types_count, sizeof *type_records);
+    InterfaceField *field_records = NULL;
+    size_t fields_count = 0, fields_allocated = 0;
+
+    for (size_t i = 0; i < types_count; i++) {
+        Type *type = types[i];
+        InterfaceType *record = &type_records[i];
+
+        record->name = interface_string(&writer, type->name);
+        record->op = type->op;
+        record->child = interface_type_id(type->child);
+        record->canonical = interface_type_id(type->canonical);
+        record->size = type->size;
+        record->align = type->align;
+        record->elements = type->elements;
+        record->declared_size = type->declared_size;
+        record->fields = fields_count;
+        record->fields_count = type->fields_count;
+        record->is_defined = type->is_defined;
+
+        field_records = interface_grow(field_records, &fields_allocated,
+                                       fields_count + type->fields_count,
+                                       sizeof *field_records);
+        for (size_t j = 0; j < type->fields_count; j++) {
+            InterfaceField *field = &field_records[fields_count++];
+            field->name = interface_string(&writer, type->fields[j].name);
+            field->type = interface_type_id(type->fields[j].type);
+            field->offset = type->fields[j].offset;
+        }
+    }
+
+    InterfaceName *names = NULL;
+    size_t names_count = 0, names_allocated = 0;
+    for (StrId id = 0; id < type_names_end(); id++) {
+        Type *type = type_get(id);
+        if (type == NULL)
+            continue;
+
+        names = interface_grow(names, &names_allocated, names_count + 1,
+                               sizeof *names);
+        names[names_count].name = interface_string(&writer, id);
+        names[names_count].type = type->id;
+        names_count++;
+    }
+
+    // Only globals are left in the outermost scope
+    size_t globals_count = global_syms->log_size;
+    InterfaceGlobal *globals = calloc(globals_count + 1, sizeof *globals);
+    for (size_t i = 0; i < globals_count; i++) {
+        Symbol *sym = global_syms->log[i];
+        globals[i].name = interface_string(&writer, sym->name);
+        globals[i].type = sym->type->id;
+
+        // Offsets are kept relative to the file, whatever base it gets
+        // when imported
+        // Canonical, so an importer finds the file from any directory
+        SourceFile *file = source_file(sym->loc.start);
+        char *file_path = file->real_path != NULL 
+            ? file->real_path : file->path;
+        globals[i].file_path = interface_string(
+            &writer, str_intern_null_term(file_path));
+        globals[i].start = sym->loc.start - file->base;
+        globals[i].end = sym->loc.end - file->base;
+    }
+
+    header.magic = INTERFACE_MAGIC;
+    header.version = INTERFACE_VERSION;
+    header.target = interface_string(
+        &writer, str_intern_null_term(type_target->name));
+    header.reorder_fields = type_reorder_fields;
+
+    size_t kept_count;
+    StrId *kept = type_layouts_kept(&kept_count);
+    uint32_t *kept_layouts = calloc(kept_count + 1, sizeof *kept_layouts);
+    for (size_t i = 0; i < kept_count; i++)
+        kept_layouts[i] = interface_string(&writer, kept[i]);
+
+    // End of the last string
+    writer.strings = interface_grow(writer.strings, &writer.strings_allocated,
+                                    writer.strings_count + 1,
+                                    sizeof(uint32_t));
+    writer.strings[writer.strings_count] = writer.chars_size;
+
+    header.strings_count = writer.strings_count;
+    header.types_count = types_count;
+    header.fields_count = fields_count;
+    header.names_count = names_count;
+    header.globals_count = globals_count;
+    header.kept_layouts_count = kept_count;
+
+    uint64_t offset = sizeof header;
+    header.strings = interface_section(&offset, (writer.strings_count + 1)
+                                       * sizeof(uint32_t));
+    header.chars = interface_section(&offset, writer.chars_size);
+    header.chars_size = writer.chars_size;
+    header.types = interface_section(&offset,
+                                     types_count * sizeof *type_records);
+    header.fields = interface_section(&offset,
+                                      fields_count * sizeof *field_records);
+    header.names = interface_section(&offset, names_count * sizeof *names);
+    header.globals = interface_section(&offset,
+                                       globals_count * sizeof *globals);
+    header.kept_layouts = interface_section(&offset, 
+                                            kept_count * sizeof(uint32_t));
+
+    bool result = false;
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        log_fatal("%s: %s.", path, strerror(errno));
+        goto clean;
+    }
+
+    fwrite(&header, sizeof header, 1, file);
+    interface_write(file, header.strings, writer.strings,
+                    (writer.strings_count + 1) * sizeof(uint32_t));
+    interface_write(file, header.chars, writer.chars, writer.chars_size);
+    interface_write(file, header.types, type_records,
+                    types_count * sizeof *type_records);
+    interface_write(file, header.fields, field_records,
+                    fields_count * sizeof *field_records);
+    interface_write(file, header.names, names, names_count * sizeof *names);
+    interface_write(file, header.globals, globals,
+                    globals_count * sizeof *globals);
+    interface_write(file, header.kept_layouts, kept_layouts,
+                    kept_count * sizeof(uint32_t));
+
+    result = !ferror(file);
+    if (fclose(file) != 0 || !result) {
+        log_fatal("%s: could not write the interface.", path);
+        result = false;
+    }
+
+clean:
+    free(types);
+    free(type_records);
+    free(field_records);
+    free(names);
+    free(globals);
+    free(kept_layouts);
+    free(writer.string_of);
+    free(writer.strings);
+    free(writer.chars);
+
+    return result;
+}
+
+// Whether count records of size at offset fit in a file of file_size bytes
+static bool interface_fits(uint64_t offset, uint64_t count,
+                           size_t size, size_t file_size)
+{
+    return offset <= file_size && offset % 8 == 0 &&
+        count <= (file_size - offset) / size;
+}
+
+static inline bool interface_is_index(uint32_t index, uint32_t count,
+                                      bool is_optional)
+{
+    return index < count || (is_optional && index == INTERFACE_NONE);
+}
+
+// Every string and type a record refers to is in range, or missing where
+// that is allowed, and every op is a TypeOp
+static bool interface_check(InterfaceHeader *header, InterfaceType *types,
+                            InterfaceField *fields, InterfaceName *names,
+                            InterfaceGlobal *globals, uint32_t *kept_layouts)
+{
+    uint32_t strings_count = header->strings_count;
+    uint32_t types_count = header->types_count;
+
+    if (!interface_is_index(header->target, strings_count, false))
+        return false;
+
+    for (uint32_t i = 0; i < types_count; i++) {
+        InterfaceType *type = &types[i];
+        if (!interface_is_index(type->name, strings_count, true) ||
+            type->op > TO_STRUCT ||
+            !interface_is_index(type->child, types_count, true) ||
+            !interface_is_index(type->canonical, types_count, true) ||
+            type->fields > header->fields_count ||
+            type->fields_count > header->fields_count - type->fields)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header->fields_count; i++) {
+        if (!interface_is_index(fields[i].name, strings_count, false) ||
+            !interface_is_index(fields[i].type, types_count, false))
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header->names_count; i++) {
+        if (!interface_is_index(names[i].name, strings_count, false) ||
+            !interface_is_index(names[i].type, types_count, false))
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header->globals_count; i++) {
+        if (!interface_is_index(globals[i].name, strings_count, false) ||
+            !interface_is_index(globals[i].file_path, strings_count, 
+                                false) ||
+            !interface_is_index(globals[i].type, types_count, false) ||
+            globals[i].start > globals[i].end)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header->kept_layouts_count; i++) {
+        if (!interface_is_index(kept_layouts[i], strings_count, false))
+            return false;
+    }
+
+    return true;
+}
+
+static bool interface_load(InterfaceHeader *header, size_t size, char *path)
+{
+    char *base = (char *) header;
+    if (size < sizeof *header ||
+        header->magic != INTERFACE_MAGIC ||
+        header->version != INTERFACE_VERSION ||
+        !interface_fits(header->strings, header->strings_count + 1ull,
+                        sizeof(uint32_t), size) ||
+        !interface_fits(header->chars, header->chars_size, 1, size) ||
+        !interface_fits(header->types, header->types_count,
+                        sizeof(InterfaceType), size) ||
+        !interface_fits(header->fields, header->fields_count,
+                        sizeof(InterfaceField), size) ||
+        !interface_fits(header->names, header->names_count,
+                        sizeof(InterfaceName), size) ||
+        !interface_fits(header->globals, header->globals_count,
+                        sizeof(InterfaceGlobal), size) ||
+        !interface_fits(header->kept_layouts, header->kept_layouts_count,
+                        sizeof(uint32_t), size)) {
+        log_fatal("%s: not a valid interface file.", path);
+        return false;
+    }
+
+    InterfaceType *records = (InterfaceType *) (base + header->types);
+    InterfaceField *fields = (InterfaceField *) (base + header->fields);
+    InterfaceName *names = (InterfaceName *) (base + header->names);
+    InterfaceGlobal *globals = (InterfaceGlobal *) (base + header->globals);
+    uint32_t *kept_layouts = (uint32_t *) (base + header->kept_layouts);
+
+    if (!interface_check(header, records, fields, names, globals, 
+                         kept_layouts)) {
+        log_fatal("%s: not a valid interface file.", path);
+        return false;
+    }
+
+    // Strings are interned once, everything refers to them by index
+    uint32_t *strings = (uint32_t *) (base + header->strings);
+    char *chars = base + header->chars;
+    StrId *ids = malloc((header->strings_count + 1) * sizeof *ids);
+    ids[header->strings_count] = STR_NONE;
+
+    for (uint32_t i = 0; i < header->strings_count; i++) {
+        if (strings[i] >= strings[i + 1] ||
+            strings[i + 1] > header->chars_size ||
+            chars[strings[i + 1] - 1] != '\0') {
+            log_fatal("%s: not a valid interface file.", path);
+            free(ids);
+            return false;
+        }
+
+        ids[i] = str_intern(chars + strings[i],
+                            strings[i + 1] - strings[i] - 1);
+    }
+
+    // Indices were checked, INTERFACE_NONE is the only one out of range
+#define INTERFACE_STRING(_i) \
+    ids[(_i) < header->strings_count ? (_i) : header->strings_count]
+#define INTERFACE_TYPE(_i) \
+    ((_i) < header->types_count ? types[(_i)] : NULL)
+
+    bool result = false;
+    Type **types = malloc(header->types_count * sizeof *types);
+
+    if (strcmp(str_chars(INTERFACE_STRING(header->target)),
+               type_target->name)) {
+        log_fatal("%s: interface is for another target, not %s.",
+                  path, type_target->name);
+        goto clean;
+    }
+
+    if (header->reorder_fields != type_reorder_fields) {
+        log_fatal("%s: interface was made %s -freorder-fields.", path,
+                  header->reorder_fields ? "with" : "without");
+        goto clean;
+    }
+
+    // Kept layouts only change anything when fields are reordered
+    size_t kept_count;
+    StrId *kept = type_layouts_kept(&kept_count);
+    bool is_kept_same = true;
+    for (uint32_t i = 0; i < header->kept_layouts_count; i++) {
+        is_kept_same &= 
+            type_is_layout_kept(INTERFACE_STRING(kept_layouts[i]));
+    }
+    for (size_t i = 0; i < kept_count; i++) {
+        bool is_in_file = false;
+        for (uint32_t j = 0; j < header->kept_layouts_count; j++)
+            is_in_file |= INTERFACE_STRING(kept_layouts[j]) == kept[i];
+
+        is_kept_same &= is_in_file;
+    }
+
+    if (type_reorder_fields && !is_kept_same) {
+        log_fatal("%s: interface was made with other -fkeep-layout "
+                  "structs.", path);
+        goto clean;
+    }
+
+    // The primitive types are made first, by type_init
+    Type *primitives[] = { type_int, type_bool, type_char, type_uint };
+    size_t primitives_count = sizeof primitives / sizeof *primitives;
+    if (header->types_count < primitives_count)
+        goto invalid;
+
+    for (uint32_t i = 0; i < header->types_count; i++) {
+        if (i < primitives_count) {
+            if (records[i].op != primitives[i]->op)
+                goto invalid;
+
+            types[i] = primitives[i];
+            continue;
+        }
+
+        Type *type = type_new(INTERFACE_STRING(records[i].name));
+        type->op = records[i].op;
+        type->size = records[i].size;
+        type->align = records[i].align;
+        type->elements = records[i].elements;
+        type->declared_size = records[i].declared_size;
+        type->is_defined = records[i].is_defined;
+        types[i] = type;
+    }
+
+    for (uint32_t i = primitives_count; i < header->types_count; i++) {
+        InterfaceType *record = &records[i];
+        Type *type = types[i];
+
+        type->child = INTERFACE_TYPE(record->child);
+        type->canonical = INTERFACE_TYPE(record->canonical);
+
+        if (record->fields_count == 0)
+            continue;
+
+        type->fields_count = record->fields_count;
+        type->fields = malloc(record->fields_count * sizeof *type->fields);
+        for (uint32_t j = 0; j < record->fields_count; j++) {
+            InterfaceField *field = &fields[record->fields + j];
+            type->fields[j].name = INTERFACE_STRING(field->name);
+            type->fields[j].type = INTERFACE_TYPE(field->type);
+            type->fields[j].offset = field->offset;
+        }
+    }
+
+    for (uint32_t i = primitives_count; i < header->types_count; i++) {
+        Type *type = types[i];
+        if ((type->op == TO_POINTER || type->op == TO_ARRAY) &&
+            type->is_defined && type->child == NULL)
+            goto invalid;
+
+        type_enter(type);
+    }
+
+    for (uint32_t i = 0; i < header->names_count; i++) {
+        type_name(INTERFACE_STRING(names[i].name), 
+                  INTERFACE_TYPE(names[i].type));
+    }
+
+    // Consecutive globals mostly share a file, which is looked up once
+    // for all of them
+    StrId last_path = STR_NONE;
+    SourceFile *file = NULL;
+
+    for (uint32_t i = 0; i < header->globals_count; i++) {
+        StrId name = INTERFACE_STRING(globals[i].name);
+        StrId file_path = INTERFACE_STRING(globals[i].file_path);
+        Type *type = INTERFACE_TYPE(globals[i].type);
+
+        if (file_path != last_path) {
+            file = source_find(str_chars(file_path));
+            last_path = file_path;
+        }
+
+        if (file == NULL)
+            goto invalid;
+
+        Location loc = {
+            .start = file->base + globals[i].start,
+            .end = file->base + globals[i].end
+        };
+
+        Symbol *sym = symbol_create(name, type, SS_GLOBAL, &loc);
+        if (!symtable_add(global_syms, sym))
+            goto invalid;
+    }
+
+    result = true;
+    goto clean;
+
+#undef INTERFACE_STRING
+#undef INTERFACE_TYPE
+
+invalid:
+    log_fatal("%s: not a valid interface file.", path);
+
+clean:
+    free(ids);
+    free(types);
+
+    return result;
+}
+
+bool interface_import(char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        log_fatal("%s: %s.", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        log_fatal("%s: not an interface file.", path);
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        log_fatal("%s: %s.", path, strerror(errno));
+        return false;
+    }
+
+    bool result = interface_load(data, st.st_size, path);
+
+    munmap(data, st.st_size);
+    return result;
+}
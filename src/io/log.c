@@ -1,6 +1,9 @@
 #include "../../include/io/log.h"
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <math.h>
 
 static const char *type_strings[] = {
@@ -13,8 +16,51 @@ static char *type_colors[] = {
 
 static char *clear_color = "\e[0m";
 
+static _Atomic size_t log_counts[LOG_TYPE_COUNT];
+
+LogFormat log_format = LOG_FORMAT_TEXT;
+size_t log_error_limit = 0;
+
+// Groups started by a message without a location come after the others,
+// in the order they were emitted
+#define LOG_KEY_UNLOCATED UINT32_MAX
+
+typedef struct LogRecord {
+    // Records are sorted by the offset their group starts at, then by the
+    // order groups were started on their thread
+    uint32_t key;
+    size_t group_seq;
+    const char *group_text;
+    size_t seq;
+
+    char *text;
+    size_t size;
+} LogRecord;
+
+// Messages come from the parser and the lexer thread
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static LogRecord *log_records;
+static size_t log_records_count;
+static size_t log_records_allocated;
+static size_t log_seq;
+static size_t log_generation = 1; // Moves on with every flush
+// Set on reaching log_error_limit, read without the lock
+static atomic_bool log_is_stopped;
+static bool log_is_stop_reported;
+
+// A message with a location starts a group. Notes and messages without
+// a location join the group last started on their thread, so they are
+// printed right after the message they belong to.
+static _Thread_local size_t log_group_generation;
+static _Thread_local size_t log_groups_count;
+static _Thread_local uint32_t log_group_key;
+static _Thread_local size_t log_group_seq;
+static _Thread_local const char *log_group_text;
+
 void log_init(bool no_colors)
 {
+    atexit(log_flush);
+
     if (!no_colors && isatty(fileno(stderr)))
         return;
 
@@ -23,79 +69,283 @@ void log_init(bool no_colors)
         type_colors[i] = clear_color;
 }
 
-void log_print(LogType type, const char *format, ...)
+size_t log_count(LogType type)
 {
-    va_list args;
-    va_start(args, format);
+    return log_counts[type];
+}
 
-    fprintf(stderr, "c0: %s%s:%s ", type_colors[type],
-            type_strings[type], clear_color);
-    vfprintf(stderr, format, args);
-    fputc('\n', stderr);
+bool log_stopped()
+{
+    return atomic_load_explicit(&log_is_stopped, memory_order_relaxed);
+}
+
+static int log_record_compare(const void *a, const void *b)
+{
+    const LogRecord *x = a;
+    const LogRecord *y = b;
+
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+
+    if (x->group_seq != y->group_seq)
+        return x->group_seq < y->group_seq ? -1 : 1;
+
+    // Groups of different threads starting at the same place
+    if (x->group_text != y->group_text) {
+        int result = strcmp(x->group_text, y->group_text);
+        if (result != 0)
+            return result;
+    }
+
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static void log_stop_message(FILE *out);
+
+static void log_flush_locked()
+{
+    if (log_records_count > 1) {
+        qsort(log_records, log_records_count, sizeof *log_records,
+              log_record_compare);
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < log_records_count; i++)
+        size += log_records[i].size;
+
+    char *output = malloc(size);
+    char *curr = output;
+    for (size_t i = 0; i < log_records_count; i++) {
+        memcpy(curr, log_records[i].text, log_records[i].size);
+        curr += log_records[i].size;
+    }
+
+    for (size_t i = 0; i < log_records_count; i++)
+        free(log_records[i].text);
+
+    fwrite(output, 1, size, stderr);
+    if (log_is_stopped && !log_is_stop_reported) {
+        log_stop_message(stderr);
+        log_is_stop_reported = true;
+    }
     fflush(stderr);
+    free(output);
 
-    va_end(args);
+    log_records_count = 0;
+    log_generation++;
 }
 
-void log_print_with_location(LogType type, Location *location,
-                             const char *format, ...)
+void log_flush()
 {
-    va_list args;
-    va_start(args, format);
+    pthread_mutex_lock(&log_lock);
+    log_flush_locked();
+    pthread_mutex_unlock(&log_lock);
+}
+
+static void log_json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+
+    for (; *s != '\0'; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+
+    fputc('"', out);
+}
+
+static void log_stop_message(FILE *out)
+{
+    const char *message = "too many errors, stopping now.";
 
-    if (location->column_start != location->column_end) {
-        fprintf(stderr, "%s:%ld:%ld-%ld: %s%s:%s ", location->file_path,
-                location->line, location->column_start, location->column_end,
-                type_colors[type], type_strings[type], clear_color);
+    if (log_format == LOG_FORMAT_JSON) {
+        fprintf(out, "{\"severity\":\"%s\",\"message\":", 
+                type_strings[LOG_FATAL]);
+        log_json_string(out, message);
+        fputs("}\n", out);
+        return;
+    }
+
+    fprintf(out, "c0: %s%s:%s %s\n", type_colors[LOG_FATAL],
+            type_strings[LOG_FATAL], clear_color, message);
+}
+
+// Takes over text
+static void log_add(LogType type, Location *location, 
+                    char *text, size_t size)
+{
+    pthread_mutex_lock(&log_lock);
+
+    if (log_is_stopped) {
+        pthread_mutex_unlock(&log_lock);
+        free(text);
+        return;
+    }
+
+    if ((location != NULL && type != LOG_INFO) || 
+        log_group_generation != log_generation) {
+        log_group_generation = log_generation;
+        log_group_key = location != NULL 
+            ? location->start 
+            : LOG_KEY_UNLOCATED;
+        log_group_seq = location != NULL ? log_groups_count++ : log_seq;
+        log_group_text = text;
+    }
+
+    if (log_records_count == log_records_allocated) {
+        log_records_allocated = log_records_allocated == 0 
+            ? 64 : log_records_allocated * 2;
+        log_records = realloc(log_records, log_records_allocated 
+                              * sizeof *log_records);
+    }
+
+    log_records[log_records_count++] = (LogRecord) {
+        .key = log_group_key,
+        .group_seq = log_group_seq,
+        .group_text = log_group_text,
+        .seq = log_seq++,
+        .text = text,
+        .size = size
+    };
+
+    log_counts[type]++;
+
+    // Whichever thread gets here, the main thread winds down and flushes
+    if (type == LOG_ERROR && log_error_limit != 0 && 
+        log_counts[LOG_ERROR] >= log_error_limit)
+        atomic_store(&log_is_stopped, true);
+
+    pthread_mutex_unlock(&log_lock);
+}
+
+// Writes the message itself, as a JSON string or as it is
+static void log_message(FILE *out, const char *format, va_list args)
+{
+    if (log_format == LOG_FORMAT_TEXT) {
+        vfprintf(out, format, args);
+        return;
+    }
+
+    char *message;
+    size_t size;
+    FILE *message_out = open_memstream(&message, &size);
+    vfprintf(message_out, format, args);
+    fclose(message_out);
+
+    log_json_string(out, message);
+    free(message);
+}
+
+void log_print(LogType type, const char *format, ...)
+{
+    char *text;
+    size_t size;
+    FILE *out = open_memstream(&text, &size);
+
+    if (log_format == LOG_FORMAT_JSON) {
+        fprintf(out, "{\"severity\":\"%s\",\"message\":", 
+                type_strings[type]);
     }
     else {
-        fprintf(stderr, "%s:%ld:%ld: %s%s:%s ", location->file_path,
-                location->line, location->column_start, type_colors[type],
+        fprintf(out, "c0: %s%s:%s ", type_colors[type],
                 type_strings[type], clear_color);
     }
 
-    vfprintf(stderr, format, args);
-    fputc('\n', stderr);
+    va_list args;
+    va_start(args, format);
+    log_message(out, format, args);
     va_end(args);
 
-    FILE *file = fopen(location->file_path, "r");
+    fputs(log_format == LOG_FORMAT_JSON ? "}\n" : "\n", out);
+    fclose(out);
+
+    log_add(type, NULL, text, size);
+}
 
-    char *line = NULL;
-    size_t n = 0, line_count = 1;
-    ssize_t chars_read;
+void log_print_with_location(LogType type, Location *location,
+                             const char *format, ...)
+{
+    SourcePosition start = source_position(location->start);
+    SourcePosition end = source_position(location->end);
+    char *file_path = start.file->path;
 
-    while (((chars_read = getline(&line, &n, file)) != -1 &&
-            line_count++ != location->line));
+    // Spans running over several lines are shown up to the end of the first
+    size_t column_start = start.column;
+    size_t column_end = end.line == start.line 
+        ? end.column 
+        : start.line_length;
+    if (column_end < column_start)
+        column_end = column_start;
 
-    fclose(file);
+    char *text;
+    size_t size;
+    FILE *out = open_memstream(&text, &size);
 
-    if (--line_count != location->line) {
-        log_error("Unreachable line number %ld in file %s",
-                  location->line, location->file_path);
-        return;
+    if (log_format == LOG_FORMAT_JSON) {
+        fprintf(out, "{\"severity\":\"%s\",\"file\":", 
+                type_strings[type]);
+        log_json_string(out, file_path);
+        fprintf(out, ",\"line\":%ld,\"column\":%ld,\"end_column\":%ld,"
+                "\"message\":", start.line, column_start, column_end);
+    }
+    else if (column_start != column_end) {
+        fprintf(out, "%s:%ld:%ld-%ld: %s%s:%s ", file_path, start.line,
+                column_start, column_end, type_colors[type],
+                type_strings[type], clear_color);
     }
+    else {
+        fprintf(out, "%s:%ld:%ld: %s%s:%s ", file_path, start.line,
+                column_start, type_colors[type], type_strings[type],
+                clear_color);
+    }
+
+    va_list args;
+    va_start(args, format);
+    log_message(out, format, args);
+    va_end(args);
 
-    fprintf(stderr, " %ld |%s", line_count, line);
-    size_t line_char_number = floor(log10(line_count)) + 1;
+    if (log_format == LOG_FORMAT_JSON) {
+        fputs("}\n", out);
+        fclose(out);
 
-    for (size_t i = 0; i < line_char_number + 2; i++)
-        fputc(' ', stderr);
+        log_add(type, location, text, size);
+        return;
+    }
 
-    fputc('|', stderr);
+    fputc('\n', out);
 
-    for (size_t i = 0; i < location->column_start - 1; i++) 
-        fputc(line[i] == '\t' ? '\t' : ' ', stderr);
+    // Taken now, streamed lines may be gone by the time it is printed
+    char *line = source_line(start.file, start.line);
+    if (line != NULL) {
+        fprintf(out, " %ld |%s", start.line, line);
+        size_t line_char_number = floor(log10(start.line)) + 1;
 
-    fputs(type_colors[type], stderr);
+        for (size_t i = 0; i < line_char_number + 2; i++)
+            fputc(' ', out);
 
-    for (size_t i = location->column_start; i <= location->column_end; i++)
-        fputc('^', stderr);
+        fputc('|', out);
 
-    fputs(clear_color, stderr);
+        // EOF is shown one column past the end of its line
+        size_t line_length = strlen(line) - 1;
+        for (size_t i = 0; i < column_start - 1; i++) 
+            fputc(i < line_length && line[i] == '\t' ? '\t' : ' ', out);
 
-    fputc('\n', stderr);
+        fputs(type_colors[type], out);
 
-    fflush(stderr);
+        for (size_t i = column_start; i <= column_end; i++)
+            fputc('^', out);
 
+        fputs(clear_color, out);
+        fputc('\n', out);
+    }
+
+    fclose(out);
     free(line);
+
+    log_add(type, location, text, size);
 }
@@ -0,0 +1,350 @@
+#include "../../include/io/source.h"
+#include "../../include/io/log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Streamed lines are appended by the lexer, which may run on another thread
+static pthread_mutex_t source_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static SourceFile **source_files;
+static size_t source_files_count;
+static size_t source_files_allocated;
+static size_t source_end;
+
+void source_init()
+{
+    source_files = NULL;
+    source_files_count = 0;
+    source_files_allocated = 0;
+    source_end = 0;
+}
+
+void source_deinit()
+{
+    for (size_t i = 0; i < source_files_count; i++) {
+        SourceFile *file = source_files[i];
+        if (file->is_owned)
+            free((char *) file->text);
+
+        free(file->real_path);
+        free(file->lines);
+        free(file->history);
+        free(file);
+    }
+
+    free(source_files);
+    source_init();
+}
+
+static SourceFile *source_new(char *path, const char *text, size_t size)
+{
+    // The file's end is an offset too
+    if (size >= UINT32_MAX - source_end) {
+        log_fatal("%s: the input is too large.", path);
+        return NULL;
+    }
+
+    SourceFile *file = calloc(1, sizeof *file);
+    file->path = path;
+    file->real_path = realpath(path, NULL);
+    file->base = source_end;
+    file->size = size;
+    file->text = text;
+
+    source_end += size + 1;
+
+    if (source_files_count == source_files_allocated) {
+        source_files_allocated = source_files_allocated == 0 
+            ? 8 : source_files_allocated * 2;
+        source_files = realloc(source_files, source_files_allocated 
+                               * sizeof *source_files);
+    }
+
+    source_files[source_files_count++] = file;
+    return file;
+}
+
+SourceFile *source_add(char *path, const char *text, size_t size)
+{
+    pthread_mutex_lock(&source_lock);
+    SourceFile *result = source_new(path, text, size);
+    pthread_mutex_unlock(&source_lock);
+
+    return result;
+}
+
+static void source_add_line(SourceFile *file, size_t start)
+{
+    if (file->lines_count == file->lines_allocated) {
+        file->lines_allocated = file->lines_allocated == 0 
+            ? 64 : file->lines_allocated * 2;
+        file->lines = realloc(file->lines, file->lines_allocated 
+                              * sizeof *file->lines);
+    }
+
+    file->lines[file->lines_count++] = start;
+}
+
+SourceFile *source_add_stream(char *path)
+{
+    pthread_mutex_lock(&source_lock);
+
+    SourceFile *result = source_new(path, NULL, 0);
+    if (result != NULL) {
+        result->is_streamed = true;
+        result->is_indexed = true;
+        source_add_line(result, 0);
+    }
+
+    pthread_mutex_unlock(&source_lock);
+    return result;
+}
+
+bool source_append(SourceFile *file, const char *text, size_t size)
+{
+    pthread_mutex_lock(&source_lock);
+
+    if (size >= UINT32_MAX - file->base - file->size) {
+        log_fatal("%s: the input is too large.", file->path);
+        pthread_mutex_unlock(&source_lock);
+        return false;
+    }
+
+    if (file->history_allocated < file->history_size + size) {
+        file->history_allocated = 2 * (file->history_size + size);
+        file->history = realloc(file->history, file->history_allocated);
+    }
+
+    memcpy(file->history + file->history_size, text, size);
+    file->history_size += size;
+
+    const char *curr = text;
+    const char *end = text + size;
+    const char *newline;
+    while ((newline = memchr(curr, '\n', end - curr)) != NULL) {
+        curr = newline + 1;
+        source_add_line(file, file->size + (curr - text));
+    }
+
+    file->size += size;
+    source_end = file->base + file->size + 1;
+
+    pthread_mutex_unlock(&source_lock);
+    return true;
+}
+
+// Index of the last line starting at or before at
+static size_t source_line_index(SourceFile *file, size_t at)
+{
+    size_t low = 0;
+    size_t high = file->lines_count;
+
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (file->lines[mid] <= at)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+void source_release(SourceFile *file, uint32_t offset)
+{
+    pthread_mutex_lock(&source_lock);
+
+    size_t line = source_line_index(file, offset - file->base);
+    line = line > SOURCE_KEPT_LINES ? line - SOURCE_KEPT_LINES : 0;
+
+    if (file->lines[line] > file->history_start) {
+        size_t dropped = file->lines[line] - file->history_start;
+        file->history_size -= dropped;
+        memmove(file->history, file->history + dropped, file->history_size);
+        file->history_start = file->lines[line];
+    }
+
+    pthread_mutex_unlock(&source_lock);
+}
+
+void source_drop_text(SourceFile *file)
+{
+    pthread_mutex_lock(&source_lock);
+    if (!file->is_owned)
+        file->text = NULL;
+    pthread_mutex_unlock(&source_lock);
+}
+
+SourceFile *source_find(char *path)
+{
+    char *real_path = realpath(path, NULL);
+
+    pthread_mutex_lock(&source_lock);
+
+    SourceFile *result = NULL;
+    for (size_t i = 0; i < source_files_count && result == NULL; i++) {
+        SourceFile *file = source_files[i];
+        if (real_path != NULL && file->real_path != NULL
+            ? !strcmp(file->real_path, real_path)
+            : !strcmp(file->path, path))
+            result = file;
+    }
+
+    if (result == NULL) {
+        struct stat st;
+        size_t size = stat(path, &st) == 0 ? (size_t) st.st_size : 0;
+        result = source_new(path, NULL, size);
+    }
+
+    pthread_mutex_unlock(&source_lock);
+
+    free(real_path);
+    return result;
+}
+
+static SourceFile *source_file_locked(uint32_t offset)
+{
+    size_t low = 0;
+    size_t high = source_files_count;
+
+    // Last file starting at or before offset
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (source_files[mid]->base <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    return source_files_count > 0 ? source_files[low] : NULL;
+}
+
+SourceFile *source_file(uint32_t offset)
+{
+    pthread_mutex_lock(&source_lock);
+    SourceFile *result = source_file_locked(offset);
+    pthread_mutex_unlock(&source_lock);
+
+    return result;
+}
+
+// Reads the text back, as much of it as there still is
+static void source_load(SourceFile *file)
+{
+    char *text = malloc(file->size + 1);
+    size_t size = 0;
+
+    int fd = open(file->path, O_RDONLY);
+    while (fd != -1 && size < file->size) {
+        ssize_t bytes_read = read(fd, text + size, file->size - size);
+        if (bytes_read == -1 && errno == EINTR)
+            continue;
+
+        if (bytes_read <= 0)
+            break;
+
+        size += bytes_read;
+    }
+
+    if (fd != -1)
+        close(fd);
+
+    memset(text + size, '\n', file->size - size);
+    file->text = text;
+    file->is_owned = true;
+}
+
+static void source_index(SourceFile *file)
+{
+    if (file->text == NULL)
+        source_load(file);
+
+    source_add_line(file, 0);
+
+    const char *text = file->text;
+    const char *end = text + file->size;
+    const char *newline;
+    while ((newline = memchr(text, '\n', end - text)) != NULL) {
+        source_add_line(file, newline + 1 - file->text);
+        text = newline + 1;
+    }
+
+    file->is_indexed = true;
+}
+
+SourcePosition source_position(uint32_t offset)
+{
+    pthread_mutex_lock(&source_lock);
+
+    SourcePosition result = {0};
+    SourceFile *file = source_file_locked(offset);
+    if (file == NULL) {
+        pthread_mutex_unlock(&source_lock);
+        return result;
+    }
+
+    if (!file->is_indexed)
+        source_index(file);
+
+    size_t at = offset - file->base;
+    if (at > file->size)
+        at = file->size;
+
+    size_t low = source_line_index(file, at);
+
+    // The end of a file that ends in a newline is shown at the end of its
+    // last line, not on a line of its own
+    if (low > 0 && at == file->size && file->lines[low] == at)
+        low--;
+
+    size_t next = low + 1 < file->lines_count 
+        ? file->lines[low + 1] - 1 
+        : file->size;
+
+    result.file = file;
+    result.line = low + 1;
+    result.column = at - file->lines[low] + 1;
+    result.line_length = next - file->lines[low];
+
+    pthread_mutex_unlock(&source_lock);
+    return result;
+}
+
+char *source_line(SourceFile *file, size_t line)
+{
+    pthread_mutex_lock(&source_lock);
+
+    if (!file->is_indexed)
+        source_index(file);
+    else if (file->text == NULL && !file->is_streamed)
+        source_load(file);
+
+    // Streamed text is kept from history_start on
+    const char *text = file->is_streamed ? file->history : file->text;
+    size_t text_start = file->is_streamed ? file->history_start : 0;
+
+    char *result = NULL;
+    if (line >= 1 && line <= file->lines_count && 
+        file->lines[line - 1] >= text_start) {
+        size_t start = file->lines[line - 1] - text_start;
+        size_t end = line < file->lines_count 
+            ? file->lines[line] - 1 - text_start
+            : file->size - text_start;
+
+        if (end > start && text[end - 1] == '\r')
+            end--;
+
+        result = malloc(end - start + 2);
+        memcpy(result, text + start, end - start);
+        result[end - start] = '\n';
+        result[end - start + 1] = '\0';
+    }
+
+    pthread_mutex_unlock(&source_lock);
+    return result;
+}
@@ -1,318 +1,711 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "../include/lexer.h"
+#include "../include/scan.h"
 
-Lexer *lexer;
+#define lexer_log_error(...)                            \
+    if (!lexer->is_quiet)                               \
+        log_print_with_location(LOG_ERROR, __VA_ARGS__)
 
-bool lexer_init(char *input_path)
+_Thread_local Lexer *lexer;
+
+typedef struct LexerChunk {
+    pthread_t thread;
+    bool is_threaded;
+
+    char *begin;
+    Lexer lexer;
+    TokenBuffer tokens;
+
+    // Where the lexer stood right after the last token of the chunk
+    char *last_curr;
+} LexerChunk;
+
+static bool lexer_read_input(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        return false;
+
+    lexer->is_streaming = false;
+    lexer->is_input_done = true;
+    lexer->fd = -1;
+    lexer->line_end = 0;
+
+    if (!S_ISREG(st.st_mode)) {
+        // Pipes, terminals, ...: stream through a window, see lexer_refill
+        lexer->source = malloc(LEXER_STREAM_WINDOW);
+        lexer->source_size = 0;
+        lexer->allocated = LEXER_STREAM_WINDOW;
+        lexer->is_mapped = false;
+        lexer->is_streaming = true;
+        lexer->is_input_done = false;
+        lexer->fd = fd;
+        return true;
+    }
+
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            lexer->source = data;
+            lexer->source_size = st.st_size;
+            lexer->is_mapped = true;
+            return true;
+        }
+    }
+
+    // Not mappable (empty, procfs, ...), read it in one go
+    size_t allocated = st.st_size > 0 ? (size_t) st.st_size : 4096;
+    size_t size = 0;
+    char *data = malloc(allocated);
+
+    ssize_t bytes_read;
+    while ((bytes_read = read(fd, data + size, allocated - size)) != 0) {
+        if (bytes_read == -1) {
+            if (errno == EINTR)
+                continue;
+
+            free(data);
+            return false;
+        }
+
+        size += bytes_read;
+        if (size == allocated) {
+            allocated *= 2;
+            data = realloc(data, allocated);
+        }
+    }
+
+    lexer->source = data;
+    lexer->source_size = size;
+    lexer->is_mapped = false;
+    return true;
+}
+
+static inline uint32_t lexer_offset(char *curr)
+{
+    return lexer->file->base + lexer->offset + (curr - lexer->source);
+}
+
+// Slides the lexeme being read, or the current position, and everything
+// after it to the front of the window, then reads from the input until
+// there is a lookahead or a whole line past the current position, so
+// pipes and terminals are lexed as their lines arrive. The window grows
+// when that would leave less than a lookahead to read into. Returns false
+// once there is nothing left to read.
+static bool lexer_refill(char **lexeme)
+{
+    if (lexer->is_input_done)
+        return false;
+
+    char *keep = lexeme != NULL ? *lexeme : lexer->curr;
+    size_t size = lexer->end - keep;
+    size_t curr = lexer->curr - keep;
+    size_t shift = keep - lexer->source;
+
+    uint32_t release = lexer_offset(keep);
+    if (lexer->parsed != NULL && atomic_load(lexer->parsed) < release)
+        release = atomic_load(lexer->parsed);
+    source_release(lexer->file, release);
+    lexer->offset += shift;
+    memmove(lexer->source, keep, size);
+    lexer->line_end = lexer->line_end > shift ? lexer->line_end - shift : 0;
+
+    if (lexer->allocated - size < LEXER_STREAM_LOOKAHEAD) {
+        lexer->allocated *= 2;
+        lexer->source = realloc(lexer->source, lexer->allocated);
+    }
+
+    if (lexer->pipeline_tokens != NULL)
+        spsc_queue_flush(lexer->pipeline_tokens);
+
+    size_t old_size = size;
+    while (size != lexer->allocated) {
+        ssize_t bytes_read = read(lexer->fd, lexer->source + size,
+                                  lexer->allocated - size);
+        if (bytes_read == -1 && errno == EINTR)
+            continue;
+
+        if (bytes_read == -1) {
+            log_fatal("%s: %s.", lexer->input_path, strerror(errno));
+            lexer->error = true;
+        }
+
+        if (bytes_read > 0 && 
+            !source_append(lexer->file, lexer->source + size, bytes_read)) {
+            lexer->error = true;
+            bytes_read = 0;
+        }
+
+        if (bytes_read <= 0) {
+            lexer->is_input_done = true;
+            break;
+        }
+
+        size += bytes_read;
+
+        for (size_t i = size; i > size - bytes_read; i--) {
+            if (scan_is(lexer->source[i - 1], SCAN_NEWLINE)) {
+                lexer->line_end = i;
+                break;
+            }
+        }
+
+        if (size - curr >= LEXER_STREAM_LOOKAHEAD || lexer->line_end > curr)
+            break;
+    }
+
+    lexer->source_size = size;
+    lexer->curr = lexer->source + curr;
+    lexer->end = lexer->source + size;
+    if (lexeme != NULL)
+        *lexeme = lexer->source;
+
+    return size != old_size;
+}
+
+bool lexer_init_fd(int fd, char *input_path)
 {
     lexer = malloc(sizeof *lexer);
 
-    lexer->input_stream = fopen(input_path, "r");
-    if (lexer->input_stream == NULL) {
+    if (!lexer_read_input(fd)) {
         log_fatal("%s: %s.", input_path, strerror(errno));
 
+        close(fd);
         free(lexer);
         return false;
     }
 
+    if (!lexer->is_streaming)
+        close(fd);
+    scan_init();
+
     lexer->input_path = input_path;
-    lexer->line = 1;
-    lexer->column = 1;
+    lexer->curr = lexer->source;
+    lexer->end = lexer->source + lexer->source_size;
+    lexer->offset = 0;
+    lexer->parsed = NULL;
+    lexer->pipeline_tokens = NULL;
     lexer->error = false;
+    lexer->is_quiet = false;
+
+    lexer->file = lexer->is_streaming 
+        ? source_add_stream(input_path)
+        : source_add(input_path, lexer->source, lexer->source_size);
+    if (lexer->file == NULL) {
+        lexer_deinit();
+        return false;
+    }
 
     return true;
 }
 
+bool lexer_init(char *input_path)
+{
+    if (!strcmp(input_path, "-"))
+        return lexer_init_fd(STDIN_FILENO, "<stdin>");
+
+    int fd = open(input_path, O_RDONLY);
+    if (fd == -1) {
+        log_fatal("%s: %s.", input_path, strerror(errno));
+        return false;
+    }
+
+    return lexer_init_fd(fd, input_path);
+}
+
 void lexer_deinit()
 {
-    if (lexer->input_stream != NULL)
-        fclose(lexer->input_stream);
+    if (lexer->file != NULL)
+        source_drop_text(lexer->file);
+
+    if (lexer->is_mapped)
+        munmap(lexer->source, lexer->source_size);
+    else
+        free(lexer->source);
+
+    if (lexer->is_streaming && lexer->fd != STDIN_FILENO)
+        close(lexer->fd);
 
     free(lexer);
 }
 
-static Token *lexer_num(Location *loc)
+static void lexer_num(Token *result, Location *loc)
 {
-    size_t allocated_chars = 64;
-    size_t lexeme_len = 0;
-    char *lexeme = malloc(allocated_chars * sizeof *lexeme);
-    char curr;
-
-    while (isdigit(curr = getc(lexer->input_stream))) {
-        lexer->column++;
-        lexeme[lexeme_len++] = curr;
-
-        if (lexeme_len == allocated_chars) {
-            allocated_chars *= 2;
-            char *tmp = realloc(lexeme, allocated_chars * sizeof *lexeme);
-            if (tmp == NULL)
-                return NULL;
-            lexeme = tmp;
-        }
-    }
+    char *lexeme = lexer->curr;
+    long value;
+    size_t hash;
 
-    if (curr != 'u') 
-        ungetc(curr, lexer->input_stream);
-    else {
-        lexeme = realloc(lexeme, (lexeme_len + 1) * sizeof *lexeme);
-        lexeme[lexeme_len++] = 'u';
-        lexer->column++;
-    }
+    lexer->curr = scan_number(lexer->curr, lexer->end, &value, &hash);
+
+    // A streamed number may go on past the window, scan it again after
+    // refilling
+    while (lexer->curr == lexer->end && lexer->is_streaming) {
+        if (!lexer_refill(&lexeme))
+            break;
 
-    loc->column_end = lexer->column - 1;
+        lexer->curr = scan_number(lexeme, lexer->end, &value, &hash);
+    }
 
-    char *str = str_get(lexeme, lexeme_len);
-    free(lexeme);
+    loc->end = lexer_offset(lexer->curr) - 1;
 
-    Token *result = token_create_with_lexeme(TT_C, loc, str);
-    result->value_as.integer = strtol(str, NULL, 10);
+    StrId str = str_intern_hashed(lexeme, lexer->curr - lexeme, hash);
 
-    return result;
+    token_init_with_lexeme(result, TT_C, loc, str);
+    result->value_as.integer = value;
 }
 
-static Token *lexer_word(Location *loc)
+static void lexer_word(Token *result, Location *loc)
 {
-    size_t allocated_chars = 8;
-    size_t lexeme_len = 0;
-    char *lexeme = malloc(allocated_chars * sizeof *lexeme);
-    char curr;
-
-    while (((curr = getc(lexer->input_stream)) == '_' ||
-            isalpha(curr) ||
-            isdigit(curr))) {
-        lexer->column++;
-        lexeme[lexeme_len++] = curr;
-
-        if (lexeme_len == allocated_chars) {
-            char *tmp = realloc(lexeme, (allocated_chars *= 2) * sizeof *lexeme);
-            if (tmp == NULL)
-                return NULL;
-            lexeme = tmp;
-        }
-    }
+    char *lexeme = lexer->curr;
+    size_t hash;
 
-    ungetc(curr, lexer->input_stream);
+    lexer->curr = scan_word(lexer->curr, lexer->end, &hash);
 
-    loc->column_end = lexer->column - 1;
-    lexeme = realloc(lexeme, (lexeme_len + 1) * sizeof *lexeme);
-    lexeme[lexeme_len] = '\0';
+    while (lexer->curr == lexer->end && lexer->is_streaming) {
+        if (!lexer_refill(&lexeme))
+            break;
 
-    Token *result;
-    if (!strcmp(lexeme, "true")) {
-        result = token_create_with_lexeme(TT_BC, loc, token_strings[TT_TRUE]);
-        result->value_as.boolean = true;
-        free(lexeme);
-        return result;
+        lexer->curr = scan_word(lexeme, lexer->end, &hash);
     }
 
-    if (!strcmp(lexeme, "false")) {
-        result = token_create_with_lexeme(TT_BC, loc, token_strings[TT_FALSE]);
-        result->value_as.boolean = false;
-        free(lexeme);
-        return result;
-    }
+    size_t lexeme_len = lexer->curr - lexeme;
+    loc->end = lexer_offset(lexer->curr) - 1;
 
-    if (!strcmp(lexeme, "null")) {
-        result = token_create_with_lexeme(TT_C, loc, token_strings[TT_NULL]);
-        result->is_null = true;
-        free(lexeme);
-        return result;
-    }
+    TokenType type = token_keyword(lexeme, lexeme_len);
+    switch (type) {
+    case TT_NA:
+        token_init_with_lexeme(result, TT_NA, loc, 
+                               str_intern_hashed(lexeme, lexeme_len, hash));
+        break;
 
-    for (int i = TT_CHAR; i < TT_KEYWORD_COUNT; i++) {
-        if (!strcmp(lexeme, token_strings[i])) {
-            free(lexeme);
-            return token_create_with_lexeme(i, loc, token_strings[i]);
-        }
-    }
+    case TT_TRUE:
+    case TT_FALSE:
+        token_init_with_lexeme(result, TT_BC, loc, type);
+        result->value_as.boolean = type == TT_TRUE;
+        break;
 
-    char *s = str_get_null_term(lexeme);
-    free(lexeme);
+    case TT_NULL:
+        token_init_with_lexeme(result, TT_C, loc, TT_NULL);
+        result->is_null = true;
+        break;
 
-    return token_create_with_lexeme(TT_NA, loc, s);
+    default:
+        token_init(result, type, loc);
+        break;
+    }
 }
 
-static bool lexer_match(const int c)
+static bool lexer_match(const char c)
 {
-    int curr = getc(lexer->input_stream);
-
-    if (curr != c) {
-        ungetc(curr, lexer->input_stream);
+    if (lexer->curr == lexer->end || *lexer->curr != c)
         return false;
-    }
 
-    lexer->column++;
+    lexer->curr++;
 
     return true;
 }
 
-Token *lexer_next()
+void lexer_scan(Token *result)
 {
     bool quit;
     Location loc;
-    Token *result;
-    size_t last_column = 0;
-
-    loc.file_path = lexer->input_path;
 
     do {
         quit = true;
 
-        int curr = getc(lexer->input_stream);
-
-        loc.column_start = loc.column_end = lexer->column;
-        loc.line = lexer->line;
-
-        if (isalpha(curr)) {
-            ungetc(curr, lexer->input_stream);
-            result = lexer_word(&loc);
+        // Past the error limit the input ends here
+        if (log_stopped()) {
+            loc.start = loc.end = lexer_offset(lexer->curr);
+            token_init(result, TT_EOF, &loc);
             break;
         }
 
-        if (isdigit(curr)) {
-            ungetc(curr, lexer->input_stream);
-            result = lexer_num(&loc);
+        // Keeps tokens other than long words and numbers within the window,
+        // unless the rest of the line already holds the next one
+        if (lexer->is_streaming && 
+            lexer->end - lexer->curr < LEXER_STREAM_LOOKAHEAD &&
+            lexer->source + lexer->line_end <= lexer->curr)
+            lexer_refill(NULL);
+
+        loc.start = loc.end = lexer_offset(lexer->curr);
+
+        if (lexer->curr == lexer->end) {
+            token_init(result, TT_EOF, &loc);
             break;
         }
 
-        switch (curr) {
-        case ' ':
-        case '\t':
-            quit = false;
-            break;
+        unsigned char curr = *lexer->curr;
 
-        case '\r':
-        case '\n':
-            lexer->line++;
-            last_column = lexer->column + 1;
-            lexer->column = 0;
+        if (scan_is(curr, SCAN_BLANK)) {
+            lexer->curr = scan_blanks(lexer->curr, lexer->end);
             quit = false;
+            continue;
+        }
+
+        if (scan_is(curr, SCAN_ALPHA)) {
+            lexer_word(result, &loc);
             break;
+        }
 
-        case EOF:
-            loc.line--;
-            loc.column_start = loc.column_end = last_column;
-            result = token_create(TT_EOF, &loc);
+        if (scan_is(curr, SCAN_DIGIT)) {
+            lexer_num(result, &loc);
             break;
+        }
+
+        lexer->curr++;
 
+        switch (curr) {
         case '&':
             if (lexer_match('&')) {
-                loc.column_end++;
-                result = token_create(TT_LOGICAL_AND, &loc);
+                loc.end++;
+                token_init(result, TT_LOGICAL_AND, &loc);
             }
             else
-                result = token_create(TT_AND, &loc);
+                token_init(result, TT_AND, &loc);
             break;
 
         case '!':
             if (lexer_match('=')) {
-                loc.column_end++;
-                result = token_create(TT_NOT_EQUALS, &loc);
+                loc.end++;
+                token_init(result, TT_NOT_EQUALS, &loc);
             }
             else
-                result = token_create(TT_NOT, &loc);
+                token_init(result, TT_NOT, &loc);
             break;
 
         case '(':
-            result = token_create(TT_LEFT_PAREN, &loc);
+            token_init(result, TT_LEFT_PAREN, &loc);
             break;
 
         case ')':
-            result = token_create(TT_RIGHT_PAREN, &loc);
+            token_init(result, TT_RIGHT_PAREN, &loc);
             break;
 
         case '*':
-            result = token_create(TT_STAR, &loc);
+            token_init(result, TT_STAR, &loc);
             break;
 
         case '+':
-            result = token_create(TT_PLUS, &loc);
+            token_init(result, TT_PLUS, &loc);
             break;
 
         case ',':
-            result = token_create(TT_COMMA, &loc);
+            token_init(result, TT_COMMA, &loc);
             break;
 
         case '-':
-            result = token_create(TT_MINUS, &loc);
+            token_init(result, TT_MINUS, &loc);
             break;
 
         case '.':
-            result = token_create(TT_DOT, &loc);
+            token_init(result, TT_DOT, &loc);
             break;
 
         case '/':
-            result = token_create(TT_SLASH, &loc);
+            token_init(result, TT_SLASH, &loc);
             break;
 
         case ';':
-            result = token_create(TT_SEMICOLON, &loc);
+            token_init(result, TT_SEMICOLON, &loc);
             break;
 
         case '>':
             if (lexer_match('=')) {
-                loc.column_end++;
-                result = token_create(TT_GREATER_EQUALS, &loc);
+                loc.end++;
+                token_init(result, TT_GREATER_EQUALS, &loc);
             }
             else
-                result = token_create(TT_GREATER, &loc);
+                token_init(result, TT_GREATER, &loc);
             break;
 
         case '=':
             if (lexer_match('=')) {
-                loc.column_end++;
-                result = token_create(TT_LOGICAL_EQUALS, &loc);
+                loc.end++;
+                token_init(result, TT_LOGICAL_EQUALS, &loc);
             }
             else 
-                result = token_create(TT_EQUALS, &loc);
+                token_init(result, TT_EQUALS, &loc);
             break;
 
         case '<':
             if (lexer_match('=')) {
-                loc.column_end++;
-                result = token_create(TT_LESS_EQUALS, &loc);
+                loc.end++;
+                token_init(result, TT_LESS_EQUALS, &loc);
             }
             else
-                result = token_create(TT_LESS, &loc);
+                token_init(result, TT_LESS, &loc);
             break;
 
         case '[':
-            result = token_create(TT_LEFT_BRACKET, &loc);
+            token_init(result, TT_LEFT_BRACKET, &loc);
             break;
 
         case ']':
-            result = token_create(TT_RIGHT_BRACKET, &loc);
+            token_init(result, TT_RIGHT_BRACKET, &loc);
             break;
 
         case '{':
-            result = token_create(TT_LEFT_BRACE, &loc);
+            token_init(result, TT_LEFT_BRACE, &loc);
             break;
 
         case '}':
-            result = token_create(TT_RIGHT_BRACE, &loc);
+            token_init(result, TT_RIGHT_BRACE, &loc);
             break;
 
         case '|':
             if (!lexer_match('|')) {
-                log_error_with_loc(&loc, "did you mean \"||\"?");
+                lexer_log_error(&loc, "did you mean \"||\"?");
                 lexer->error = true;
             }
-            loc.column_end++;
-            result = token_create(TT_LOGICAL_OR, &loc);
+            loc.end++;
+            token_init(result, TT_LOGICAL_OR, &loc);
             break;
 
         case '@':
-            result = token_create(TT_AT, &loc);
+            token_init(result, TT_AT, &loc);
             break;
 
         default:
-            log_error_with_loc(&loc, "unexpected character \"%c\".", curr);
+            lexer_log_error(&loc, "unexpected character \"%c\".", curr);
             quit = false;
             lexer->error = true;
         }
 
-        lexer->column++;
-
     } while (!quit);
+}
 
+Token *lexer_next()
+{
+    Token *result = malloc(sizeof *result);
+    lexer_scan(result);
     return result;
 }
+
+void lexer_tokenize(TokenBuffer *buffer)
+{
+    // Parsing starts once every token is kept, and may report on any line,
+    // so no streamed text is released meanwhile
+    atomic_uint parsed;
+    atomic_init(&parsed, lexer_offset(lexer->curr));
+    atomic_uint *old_parsed = lexer->parsed;
+    lexer->parsed = &parsed;
+
+    Token token;
+
+    do {
+        lexer_scan(&token);
+        token_buffer_push(buffer, &token);
+    } while (token.type != TT_EOF);
+
+    lexer->parsed = old_parsed;
+}
+
+static void lexer_chunk_scan(LexerChunk *chunk)
+{
+    Token token;
+
+    chunk->last_curr = NULL;
+
+    while (true) {
+        lexer_scan(&token);
+        if (token.type == TT_EOF)
+            break;
+
+        token_buffer_push(&chunk->tokens, &token);
+        chunk->last_curr = lexer->curr;
+    }
+}
+
+static void *lexer_chunk_run(void *arg)
+{
+    LexerChunk *chunk = arg;
+
+    lexer = &chunk->lexer;
+    lexer_chunk_scan(chunk);
+
+    return NULL;
+}
+
+// First split point at or after curr: just past a newline, which can 
+// never be part of a token
+static char *lexer_chunk_boundary(char *curr, char *end)
+{
+    while (curr < end && !scan_is(*curr, SCAN_NEWLINE))
+        curr++;
+
+    return curr < end ? curr + 1 : end;
+}
+
+void lexer_tokenize_parallel(TokenBuffer *buffer, size_t jobs)
+{
+    Lexer *main_lexer = lexer;
+    size_t size = main_lexer->end - main_lexer->curr;
+
+    // Only a whole input can be split
+    if (main_lexer->is_streaming)
+        jobs = 1;
+
+    if (jobs > size / LEXER_MIN_CHUNK_SIZE)
+        jobs = size / LEXER_MIN_CHUNK_SIZE;
+
+    if (jobs <= 1) {
+        lexer_tokenize(buffer);
+        return;
+    }
+
+    LexerChunk *chunks = malloc(jobs * sizeof *chunks);
+
+    char *begin = main_lexer->curr;
+    for (size_t i = 0; i < jobs; i++) {
+        char *end = i == jobs - 1
+            ? main_lexer->end
+            : lexer_chunk_boundary(begin + size / jobs, main_lexer->end);
+
+        LexerChunk *chunk = &chunks[i];
+        chunk->begin = begin;
+        chunk->lexer = *main_lexer;
+        chunk->lexer.curr = begin;
+        chunk->lexer.end = end;
+        chunk->lexer.is_quiet = true;
+        chunk->lexer.error = false;
+        token_buffer_create(&chunk->tokens, (end - begin) / 4);
+
+        chunk->is_threaded = pthread_create(&chunk->thread, NULL,
+                                            lexer_chunk_run, chunk) == 0;
+        if (!chunk->is_threaded) {
+            lexer_chunk_run(chunk);
+            lexer = main_lexer;
+        }
+
+        begin = end;
+    }
+
+    for (size_t i = 0; i < jobs; i++) {
+        if (chunks[i].is_threaded)
+            pthread_join(chunks[i].thread, NULL);
+    }
+
+    // Offsets are into the whole input, so the chunks are joined as they are
+    LexerChunk *last = NULL;
+
+    for (size_t i = 0; i < jobs; i++) {
+        LexerChunk *chunk = &chunks[i];
+
+        if (chunk->lexer.error) {
+            // Lex it again on this thread to report its errors in order
+            chunk->tokens.size = 0;
+            chunk->lexer.curr = chunk->begin;
+            chunk->lexer.is_quiet = main_lexer->is_quiet;
+
+            lexer = &chunk->lexer;
+            lexer_chunk_scan(chunk);
+            lexer = main_lexer;
+        }
+
+        token_buffer_append(buffer, &chunk->tokens);
+
+        if (chunk->last_curr != NULL)
+            last = chunk;
+
+        main_lexer->error |= chunk->lexer.error;
+    }
+
+    // Lex TT_EOF from right after the last token, exactly like lexer_tokenize
+    // would have. Any errors on the way were already reported by the chunks.
+    if (last != NULL)
+        main_lexer->curr = last->last_curr;
+
+    bool is_quiet = main_lexer->is_quiet;
+    main_lexer->is_quiet = true;
+
+    Token eof;
+    lexer_scan(&eof);
+    token_buffer_push(buffer, &eof);
+
+    main_lexer->is_quiet = is_quiet;
+
+    for (size_t i = 0; i < jobs; i++)
+        token_buffer_destroy(&chunks[i].tokens);
+    free(chunks);
+}
+
+static void *lexer_pipeline_run(void *arg)
+{
+    LexerPipeline *pipeline = arg;
+    Token token;
+
+    lexer = pipeline->lexer;
+
+    do {
+        lexer_scan(&token);
+        if (!spsc_queue_push(&pipeline->tokens, &token))
+            break;
+    } while (token.type != TT_EOF);
+
+    spsc_queue_flush(&pipeline->tokens);
+    spsc_queue_close(&pipeline->tokens);
+
+    return NULL;
+}
+
+bool lexer_pipeline_start(LexerPipeline *pipeline)
+{
+    spsc_queue_create(&pipeline->tokens, sizeof(Token), LEXER_PIPELINE_SIZE);
+    pipeline->is_done = false;
+    pipeline->lexer = lexer;
+    atomic_init(&pipeline->parsed, lexer_offset(lexer->curr));
+    lexer->parsed = &pipeline->parsed;
+    lexer->pipeline_tokens = &pipeline->tokens;
+
+    // Stands in if the queue closes before TT_EOF arrives
+    Location loc = { lexer_offset(lexer->end), lexer_offset(lexer->end) };
+    token_init(&pipeline->eof, TT_EOF, &loc);
+
+    int error = pthread_create(&pipeline->thread, NULL, 
+                               lexer_pipeline_run, pipeline);
+    if (error != 0) {
+        log_fatal("could not start the lexer thread: %s.", strerror(error));
+        spsc_queue_destroy(&pipeline->tokens);
+        lexer->parsed = NULL;
+        lexer->pipeline_tokens = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void lexer_pipeline_next(LexerPipeline *pipeline, Token *dest)
+{
+    if (!pipeline->is_done && spsc_queue_pop(&pipeline->tokens, dest)) {
+        atomic_store(&pipeline->parsed, dest->loc.start);
+        if (dest->type != TT_EOF)
+            return;
+
+        pipeline->eof = *dest;
+        pipeline->is_done = true;
+        return;
+    }
+
+    *dest = pipeline->eof;
+}
+
+void lexer_pipeline_stop(LexerPipeline *pipeline)
+{
+    // Lexes the rest of the input, so the errors reported are the same
+    // whatever token the parser stopped at
+    Token token;
+    while (!pipeline->is_done && spsc_queue_pop(&pipeline->tokens, &token)) {
+        atomic_store(&pipeline->parsed, token.loc.start);
+        pipeline->is_done = token.type == TT_EOF;
+    }
+
+    spsc_queue_close(&pipeline->tokens);
+    pthread_join(pipeline->thread, NULL);
+    pipeline->lexer->parsed = NULL;
+    pipeline->lexer->pipeline_tokens = NULL;
+    spsc_queue_destroy(&pipeline->tokens);
+}
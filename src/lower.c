@@ -0,0 +1,336 @@
+#include "../include/lower.h"
+
+bool lower_split_arrays = true;
+
+static bool lower_expr(Expr **e);
+
+static Expr *lower_path(Expr *e);
+
+// The field e reaches in an element of a split array, NULL if it does not
+static Field *lower_split_field(Expr *e)
+{
+    Expr *element = e->as.access.left;
+    if (element->type != ET_ARR_ACCESS || 
+        element->as.arr_access.left->type != ET_NA)
+        return NULL;
+
+    Symbol *sym = element->as.arr_access.left->as.na.sym;
+    if (sym == NULL || !sym->is_split)
+        return NULL;
+
+    Type *array = type_canonical(sym->type);
+    return type_field(type_canonical(array->child), e->as.access.na);
+}
+
+// The field of an element, as an element of the field's own array
+static Expr *lower_split_path(Expr *e, Field *field)
+{
+    Expr *element = e->as.access.left;
+    if (!lower_expr(&element->as.arr_access.index))
+        return NULL;
+
+    Symbol *sym = element->as.arr_access.left->as.na.sym;
+    Type *type = type_canonical(field->type);
+
+    Expr *path = expr_path(sym, NULL, type, &e->loc);
+    path->as.path.offset = type_split_offset(type_canonical(sym->type), 
+                                             field);
+    expr_path_index(path, element->as.arr_access.index, type->size);
+
+    return path;
+}
+
+static Expr *lower_path(Expr *e)
+{
+    switch (e->type) {
+    case ET_NA:
+        {
+            // Undefined names were reported by the parser
+            Symbol *sym = e->as.na.sym;
+            if (sym == NULL)
+                return NULL;
+
+            return expr_path(sym, NULL, type_canonical(sym->type), &e->loc);
+        }
+
+    case ET_ACCESS:
+        {
+            Field *split = lower_split_field(e);
+            if (split != NULL)
+                return lower_split_path(e, split);
+
+            Expr *path = lower_path(e->as.access.left);
+            if (path == NULL)
+                return NULL;
+
+            Type *type = path->as.path.type;
+            Field *field = NULL;
+            if (type->is_defined && type->op == TO_STRUCT)
+                field = type_field(type, e->as.access.na);
+
+            if (field == NULL) {
+                log_error_with_loc(&e->loc, "no field named %s.",
+                                   str_chars(e->as.access.na));
+                return NULL;
+            }
+
+            path->as.path.offset += field->offset;
+            path->as.path.type = type_canonical(field->type);
+            path->loc = e->loc;
+            return path;
+        }
+
+    case ET_ARR_ACCESS:
+        {
+            Expr *path = lower_path(e->as.arr_access.left);
+            if (path == NULL)
+                return NULL;
+
+            Type *type = path->as.path.type;
+            if (!type->is_defined || type->op != TO_ARRAY) {
+                log_error_with_loc(&e->loc, "only arrays can be indexed.");
+                return NULL;
+            }
+
+            if (!lower_expr(&e->as.arr_access.index))
+                return NULL;
+
+            Type *child = type_canonical(type->child);
+            expr_path_index(path, e->as.arr_access.index, child->size);
+            path->as.path.type = child;
+            path->loc = e->loc;
+            return path;
+        }
+
+    case ET_UNARY:
+        {
+            Expr *operand = e->as.unary.e;
+            if (e->as.unary.op != TT_AT) {
+                log_error_with_loc(&e->loc,
+                                   "an address has no fields or elements.");
+                return NULL;
+            }
+
+            // Dereferencing an address taken in the same path
+            if (operand->type == ET_UNARY && operand->as.unary.op == TT_AND) {
+                Expr *path = lower_path(operand->as.unary.e);
+                if (path != NULL)
+                    path->loc = e->loc;
+
+                return path;
+            }
+
+            Expr *pointer = lower_path(operand);
+            if (pointer == NULL)
+                return NULL;
+
+            Type *type = pointer->as.path.type;
+            if (!type->is_defined || type->op != TO_POINTER) {
+                log_error_with_loc(&e->loc,
+                                   "only pointers can be dereferenced.");
+                return NULL;
+            }
+
+            return expr_path(NULL, pointer,
+                             type_canonical(type->child), &e->loc);
+        }
+
+    default:
+        return NULL;
+    }
+}
+
+// Moves constant indices, and constant terms added to or subtracted from
+// an index, into the offset
+static void lower_fold(Expr *path)
+{
+    if (path->as.path.pointer != NULL)
+        lower_fold(path->as.path.pointer);
+
+    size_t count = 0;
+    for (size_t i = 0; i < path->as.path.indices_count; i++) {
+        Expr *index = path->as.path.indices[i].index;
+        long scale = path->as.path.indices[i].scale;
+
+        while (index->type == ET_BINARY) {
+            TokenType op = index->as.binary.op;
+            Expr *left = index->as.binary.left;
+            Expr *right = index->as.binary.right;
+
+            Expr *rest;
+            if ((op == TT_PLUS || op == TT_MINUS) && right->type == ET_C) {
+                long c = op == TT_PLUS ? right->as.c : -right->as.c;
+                path->as.path.offset += c * scale;
+                rest = left;
+            }
+            else if (op == TT_PLUS && left->type == ET_C) {
+                path->as.path.offset += left->as.c * scale;
+                rest = right;
+            }
+            else
+                break;
+
+            index = rest;
+        }
+
+        if (index->type == ET_C) {
+            path->as.path.offset += index->as.c * scale;
+            continue;
+        }
+
+        path->as.path.indices[count].index = index;
+        path->as.path.indices[count].scale = scale;
+        count++;
+    }
+
+    path->as.path.indices_count = count;
+}
+
+static bool lower_expr(Expr **e)
+{
+    Expr *curr = *e;
+
+    switch (curr->type) {
+    case ET_BINARY:
+        {
+            bool left = lower_expr(&curr->as.binary.left);
+            bool right = lower_expr(&curr->as.binary.right);
+            return left && right;
+        }
+
+    case ET_UNARY:
+        if (curr->as.unary.op != TT_AT)
+            return lower_expr(&curr->as.unary.e);
+        // fallthrough
+
+    case ET_NA:
+    case ET_ACCESS:
+    case ET_ARR_ACCESS:
+        {
+            Expr *path = lower_path(curr);
+            if (path == NULL)
+                return false;
+
+            lower_fold(path);
+            *e = path;
+            return true;
+        }
+
+    default:
+        return true;
+    }
+}
+
+// Unsplits the arrays used other than to reach a field of an element.
+// Parents come after their children, so walking the nodes backwards sees
+// each access before the name of the array it reaches into.
+static void lower_scan_tree(AstBuffer *tree)
+{
+    bool *is_element_of = calloc(tree->size, sizeof *is_element_of);
+
+    for (size_t i = tree->size; i-- > 0;) {
+        switch (tree->kinds[i]) {
+        case ET_ACCESS:
+            {
+                AstNode left = tree->lhs[i];
+                if (tree->kinds[left] == ET_ARR_ACCESS && 
+                    tree->kinds[tree->lhs[left]] == ET_NA)
+                    is_element_of[tree->lhs[left]] = true;
+            }
+            break;
+
+        case ET_NA:
+            if (!is_element_of[i] && tree->rhs[i] != AST_NONE)
+                tree->syms[tree->rhs[i]]->is_split = false;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    free(is_element_of);
+}
+
+// Arguments are laid out by the caller, so only locals are split
+static void lower_find_splits(Function *fun, AstBuffer *tree)
+{
+    for (size_t i = fun->arg_count; i < fun->locals_count; i++) {
+        Symbol *sym = fun->locals[i];
+        Type *type = type_canonical(sym->type);
+
+        sym->is_split = type->is_defined && type->op == TO_ARRAY && 
+            type->child->is_defined && 
+            type_canonical(type->child)->op == TO_STRUCT &&
+            type_split_size(type) <= type->size;
+    }
+
+    lower_scan_tree(tree);
+}
+
+static bool lower_stmts(Stmt **stmts);
+
+static bool lower_stmt(Stmt *stmt)
+{
+    switch (stmt->type) {
+    case ST_ASSIGN:
+        {
+            bool left = lower_expr(&stmt->as.assign.left);
+            bool right = lower_expr(&stmt->as.assign.right);
+            return left && right;
+        }
+
+    case ST_IF:
+        {
+            bool cond = lower_expr(&stmt->as.if_stmt.cond);
+            bool then_block = lower_stmts(stmt->as.if_stmt.then_block);
+            bool else_block = lower_stmts(stmt->as.if_stmt.else_block);
+            return cond && then_block && else_block;
+        }
+
+    case ST_WHILE:
+        {
+            bool cond = lower_expr(&stmt->as.while_stmt.cond);
+            bool block = lower_stmts(stmt->as.while_stmt.block);
+            return cond && block;
+        }
+
+    case ST_FUNCALL:
+        {
+            bool result = lower_expr(&stmt->as.funcall.left);
+
+            Expr **args = stmt->as.funcall.args;
+            for (size_t i = 0; args != NULL && args[i] != NULL; i++)
+                result = lower_expr(&args[i]) && result;
+
+            return result;
+        }
+
+    case ST_NEW:
+        return lower_expr(&stmt->as.new_stmt.left);
+
+    case ST_RETURN:
+        return lower_expr(&stmt->as.return_stmt);
+    }
+
+    return true;
+}
+
+static bool lower_stmts(Stmt **stmts)
+{
+    bool result = true;
+    for (size_t i = 0; stmts != NULL && stmts[i] != NULL; i++)
+        result = lower_stmt(stmts[i]) && result;
+
+    return result;
+}
+
+bool lower_function(Function *fun, AstBuffer *tree)
+{
+    if (lower_split_arrays)
+        lower_find_splits(fun, tree);
+
+    bool stmts = lower_stmts(fun->stmts);
+    bool return_stmt = lower_stmt(fun->return_stmt);
+    return stmts && return_stmt;
+}
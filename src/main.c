@@ -1,27 +1,178 @@
 #include "../include/parser.h"
+#include "../include/lower.h"
+#include "../include/interface.h"
 #include "../include/type.h"
 #include "../include/symbol_table.h"
 
+static void usage(FILE *out)
+{
+    fputs("usage: c0 [options] file\n"
+          "  -ftarget=NAME              x86, x86-64 or dlx, default x86-64\n"
+          "  -fpretokenize              lex the whole input before parsing\n"
+          "  -fpipeline                 lex on a thread of its own\n"
+          "  -fparallel-lex=N           lex chunks of the input on N threads\n"
+          "  -freorder-fields           lay struct fields out by alignment\n"
+          "  -fkeep-layout=NAME         keep struct NAME in declared order\n"
+          "  -fno-split-arrays          keep arrays of structs whole\n"
+          "  -femit-interface=PATH      write typedefs and globals to PATH\n"
+          "  -fimport-interface=PATH    read typedefs and globals from PATH\n"
+          "  -ferror-limit=N            stop after N errors, 0 for none\n"
+          "  -fdiagnostics-format=FMT   text or json\n"
+          "  --layout-report            print the layout of every struct\n"
+          "  --help                     print this and exit\n", out);
+}
+
 int main(int argc, char **argv)
 {
-    (void) argc;
+    char *input_path = NULL;
+    bool pretokenize = false;
+    bool pipeline = false;
+    size_t lex_jobs = 1;
+    const Target *target = target_default;
+    bool layout_report = false;
+    char *emit_path = NULL;
+    char *import_path = NULL;
+    char **kept_layouts = malloc(argc * sizeof *kept_layouts);
+    size_t kept_layouts_count = 0;
 
     log_init(true);
+    source_init();
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-fpretokenize"))
+            pretokenize = true;
+        else if (!strcmp(argv[i], "-fpipeline"))
+            pipeline = true;
+        else if (!strncmp(argv[i], "-fparallel-lex=", 15)) {
+            char *end;
+            lex_jobs = strtoul(argv[i] + 15, &end, 10);
+            if (*end != '\0' || lex_jobs == 0) {
+                log_fatal("invalid thread count in \"%s\".", argv[i]);
+                return 1;
+            }
+
+            // Chunks are joined into one token buffer
+            pretokenize = true;
+        }
+        else if (!strncmp(argv[i], "-ftarget=", 9)) {
+            target = target_find(argv[i] + 9);
+            if (target == NULL) {
+                log_fatal("unknown target \"%s\", expected x86, x86-64 "
+                          "or dlx.", argv[i] + 9);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-freorder-fields"))
+            type_reorder_fields = true;
+        else if (!strncmp(argv[i], "-fkeep-layout=", 14))
+            kept_layouts[kept_layouts_count++] = argv[i] + 14;
+        else if (!strcmp(argv[i], "-fno-split-arrays"))
+            lower_split_arrays = false;
+        else if (!strncmp(argv[i], "-femit-interface=", 17))
+            emit_path = argv[i] + 17;
+        else if (!strncmp(argv[i], "-fimport-interface=", 19))
+            import_path = argv[i] + 19;
+        else if (!strncmp(argv[i], "-ferror-limit=", 14)) {
+            char *end;
+            log_error_limit = strtoul(argv[i] + 14, &end, 10);
+            if (*end != '\0' || argv[i][14] == '\0') {
+                log_fatal("invalid error limit in \"%s\".", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-fdiagnostics-format=text"))
+            log_format = LOG_FORMAT_TEXT;
+        else if (!strcmp(argv[i], "-fdiagnostics-format=json"))
+            log_format = LOG_FORMAT_JSON;
+        else if (!strcmp(argv[i], "--layout-report"))
+            layout_report = true;
+        else if (!strcmp(argv[i], "--help")) {
+            usage(stdout);
+            return 0;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            log_fatal("unknown option \"%s\".", argv[i]);
+            return 1;
+        }
+        else
+            input_path = argv[i];
+    }
+
+    if (input_path == NULL) {
+        log_fatal("no input file.");
+        log_flush();
+        usage(stderr);
+        return 1;
+    }
+
+    if (pretokenize && pipeline) {
+        log_fatal("-fpipeline cannot be combined with "
+                  "-fpretokenize or -fparallel-lex.");
+        return 1;
+    }
 
-    type_init();
+    str_init(token_strings, TT_KEYWORD_COUNT);
+    type_init(target);
+    for (size_t i = 0; i < kept_layouts_count; i++)
+        type_keep_layout(str_intern_null_term(kept_layouts[i]));
+    free(kept_layouts);
     symtable_init();
+    ast_init();
+
+    if (import_path != NULL && !interface_import(import_path))
+        return 1;
+
+    if (!lexer_init(input_path))
+        return 1;
+
+    TokenBuffer tokens;
+    if (pretokenize) {
+        // Roughly one token per four bytes of source
+        token_buffer_create(&tokens, lexer->source_size / 4);
+        lexer_tokenize_parallel(&tokens, lex_jobs);
+    }
+
+    LexerPipeline lexer_thread;
+    if (pipeline && !lexer_pipeline_start(&lexer_thread))
+        return 1;
+
+    parser_init(pretokenize ? &tokens : NULL, 
+                pipeline ? &lexer_thread : NULL);
+
+    Function *f = parser_prog();
+
+    if (layout_report)
+        type_layout_report(stdout);
 
-    lexer_init(argv[1]);
-    parser_init();
+    if (emit_path != NULL && log_count(LOG_ERROR) == 0 && 
+        !interface_emit(emit_path))
+        return 1;
 
-    Function *f = parser_fud(parser);
+    // Past the error limit lowering could only report more
+    if (f != NULL && !log_stopped()) {
+        // Roughly one node per two tokens
+        AstBuffer tree;
+        ast_buffer_create(&tree, lexer->source_size / 8);
+        ast_buffer_add_function(&tree, f);
 
+        lower_function(f, &tree);
+        ast_buffer_destroy(&tree);
+    }
     if (f != NULL)
         function_free(f);
 
     parser_deinit();
+    if (pretokenize)
+        token_buffer_destroy(&tokens);
+    if (pipeline)
+        lexer_pipeline_stop(&lexer_thread);
+    lexer_deinit();
+    ast_deinit();
     symtable_deinit();
     type_deinit();
+    str_deinit();
+    source_deinit();
 
-    return 0;
+    log_flush();
+    return log_count(LOG_ERROR) != 0 || log_count(LOG_FATAL) != 0;
 }
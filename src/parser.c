@@ -3,27 +3,38 @@
 #include "../include/symbol_table.h"
 
 #define parser_log_info(...)                            \
-    if (!parser->is_tracking)                           \
-        log_print_with_location(LOG_INFO, __VA_ARGS__)
+    log_print_with_location(LOG_INFO, __VA_ARGS__)
 
 #define parser_log_error(...)                           \
-    if (!parser->is_tracking)                           \
-        log_print_with_location(LOG_ERROR, __VA_ARGS__)        
+    log_print_with_location(LOG_ERROR, __VA_ARGS__)        
 
 Parser *parser = NULL;
 
-void parser_init()
+static Token *parser_lex()
+{
+    if (parser->pipeline == NULL)
+        return lexer_next();
+
+    Token *result = malloc(sizeof *result);
+    lexer_pipeline_next(parser->pipeline, result);
+    return result;
+}
+
+void parser_init(TokenBuffer *buffer, LexerPipeline *pipeline)
 {
     parser = malloc(sizeof *parser);
     parser->lexer = lexer;
     parser->error = false;
-    parser->is_tracking = false;
-    parser->oldest_state = 0;
     parser->curr_token = 0;
+    parser->buffer = buffer;
+    parser->pipeline = pipeline;
     cyclic_queue_create(&parser->tokens, sizeof(Token *), 8);
 
+    if (buffer != NULL)
+        return;
+
     for (size_t i = 0; i < PARSER_LOOK_AHEAD; i++) {
-        Token *new = lexer_next(lexer);
+        Token *new = parser_lex();
         cyclic_queue_enqueue(&parser->tokens, &new);
     }
 }
@@ -42,8 +53,18 @@ void parser_deinit()
 
 static Token *parser_get_token()
 {
+    if (parser->buffer != NULL) {
+        // Past the error limit the rest is read as TT_EOF, the last token
+        size_t index = log_stopped() 
+            ? parser->buffer->size - 1 
+            : parser->curr_token;
+        size_t slot = parser->curr_token++ % PARSER_TOKEN_WINDOW;
+        token_buffer_get(parser->buffer, index, &parser->window[slot]);
+        return &parser->window[slot];
+    }
+
     if (parser->curr_token == parser->tokens.size) {
-        Token *new = lexer_next(parser->lexer);
+        Token *new = parser_lex();
         cyclic_queue_enqueue(&parser->tokens, &new);
     }
 
@@ -51,7 +72,7 @@ static Token *parser_get_token()
                                                     parser->curr_token);
 
     parser->curr_token++;
-    if (!parser->is_tracking && parser->curr_token > PARSER_LOOK_AHEAD) { 
+    if (parser->curr_token > PARSER_LOOK_AHEAD) { 
         Token *first = *(Token **) cyclic_queue_offset(&parser->tokens, 0);
         token_destroy(first);
         cyclic_queue_dequeue(&parser->tokens, NULL);
@@ -79,8 +100,8 @@ static Token *parser_expect(TokenType type)
         parser_log_error(&curr->loc,
                          "expected \"%s\", but got \"%s\".",
                          token_strings[type],
-                         curr->lexeme);
-        parser->error = !parser->is_tracking;
+                         str_chars(curr->lexeme));
+        parser->error = true;
         parser_unget_token();
         return NULL;
     }
@@ -88,34 +109,19 @@ static Token *parser_expect(TokenType type)
     return curr;
 }
 
-static size_t parser_state()
-{
-    if (!parser->is_tracking) {
-        parser->oldest_state = parser->curr_token;
-        parser->is_tracking = true;
-    }
-
-    return parser->curr_token;
-}
-
-static void parser_set_state(size_t state)
+// Binds the name just read to its symbol in table, once, as the node for it
+// is built
+static Symbol *parser_resolve(SymTable *table, Token *na, bool is_function)
 {
-    parser->curr_token = state;
-}
-
-static void parser_drop_state(size_t state)
-{
-    if (!parser->is_tracking || state != parser->oldest_state)
-        return;
-
-    while (parser->curr_token > PARSER_LOOK_AHEAD) {
-        Token **first = cyclic_queue_offset(&parser->tokens, 0);
-        token_destroy(*first);
-        cyclic_queue_dequeue(&parser->tokens, NULL); 
-        parser->curr_token--;
-    }
-
-    parser->is_tracking = false;
+    Symbol *sym = symtable_get(table, na->lexeme);
+    if (sym != NULL)
+        return sym;
+
+    log_print_with_location(LOG_ERROR, &na->loc, "undefined %s %s.",
+                            is_function ? "function" : "variable",
+                            str_chars(na->lexeme));
+    parser->error = true;
+    return NULL;
 }
 
 static TokenType parser_panic(size_t types_count, ...)
@@ -150,7 +156,7 @@ Expr *parser_id()
         return NULL;
 
     bool quit = false;
-    Expr *e = expr_na(curr);
+    Expr *e = expr_na(curr, parser_resolve(global_syms, curr, false));
     while (!quit) {
         curr = parser_get_token();
         switch (curr->type) {
@@ -158,26 +164,26 @@ Expr *parser_id()
             {
                 Expr *index = parser_e();
                 if (index == NULL)
-                    goto clean_e;
+                    return NULL;
 
                 Token *r_bracket = parser_expect(TT_RIGHT_BRACKET);
                 if (r_bracket == NULL)
-                    goto clean_e;
+                    return NULL;
 
-                e = expr_arr_access(e, index, r_bracket->loc.column_end);
+                e = expr_arr_access(e, index, r_bracket->loc.end);
             }
             break;
 
         case TT_AT:
         case TT_AND:
-            e = expr_unary(curr->type, e, curr->loc.column_end, false);
+            e = expr_unary(curr->type, e, curr->loc.end, false);
             break;
 
         case TT_DOT:
             {
                 Token *na = parser_expect(TT_NA);
                 if (na == NULL)
-                    goto clean_e;
+                    return NULL;
 
                 e = expr_access(na, e);
             }
@@ -191,283 +197,232 @@ Expr *parser_id()
     parser_unget_token();
 
     return e;
-
-clean_e:
-    expr_free(e);
-    return NULL; 
 }
 
-Expr *parser_f()
+// How tightly a binary operator binds, PREC_NONE for any other token
+typedef enum Precedence {
+    PREC_NONE,
+    PREC_OR,
+    PREC_AND,
+    PREC_COMPARISON,
+    PREC_SUM,
+    PREC_PRODUCT
+} Precedence;
+
+static Precedence parser_precedence(TokenType type)
 {
-    Token *curr = parser_get_token();
-
-    switch (curr->type) {
+    switch (type) {
+    case TT_LOGICAL_OR:
+        return PREC_OR;
+
+    case TT_LOGICAL_AND:
+        return PREC_AND;
+
+    case TT_GREATER:
+    case TT_GREATER_EQUALS:
+    case TT_LESS:
+    case TT_LESS_EQUALS:
+    case TT_LOGICAL_EQUALS:
+    case TT_NOT_EQUALS:
+        return PREC_COMPARISON;
+
+    case TT_PLUS:
     case TT_MINUS:
-        {
-            size_t column = curr->loc.column_start;
-            Expr *f = parser_f();
-            if (f == NULL)
-                return NULL;
-
-            return expr_unary(TT_MINUS, f, column, true);
-        }
+        return PREC_SUM;
 
-    case TT_LEFT_PAREN:
-        {
-            Location left_loc = curr->loc;
-            Expr *result = parser_e();
-            if (result == NULL)
-                return NULL;
-
-            Token *r = parser_expect(TT_RIGHT_PAREN);
-            if (r == NULL) {
-                expr_free(result);
-                parser_log_info(&left_loc,
-                                "right prarenphesis is here:");
-                return NULL;
-            }
-
-            result->loc.column_start = left_loc.column_start;
-            result->loc.column_end = r->loc.column_end;
-            return result;
-        }
-
-    case TT_C:
-        return expr_c(curr);
-
-    case TT_NA:
-        parser_unget_token();
-        return parser_id();
+    case TT_STAR:
+    case TT_SLASH:
+        return PREC_PRODUCT;
 
     default:
-        parser_unget_token();
-        parser_log_error(&curr->loc,
-                         "expected factor instead of \"%s\".",
-                         curr->lexeme);
-        return NULL;
+        return PREC_NONE;
     }
 }
 
-Expr *parser_t()
+// Whether e can only be boolean, or only arithmetic. A name, and the
+// fields, elements and dereferences reached from it, can be either.
+static bool parser_is_bool(Expr *e)
 {
-    Expr *e = parser_f();
-    if (e == NULL)
-        return NULL;
+    switch (e->type) {
+    case ET_BC:
+        return true;
 
-    Token *curr = parser_get_token();
-    while ((token_is_type(curr, TT_STAR) ||
-            token_is_type(curr, TT_SLASH))) {
-        TokenType type = curr->type;
+    case ET_BINARY:
+        return parser_precedence(e->as.binary.op) <= PREC_COMPARISON;
 
-        Expr *f = parser_f();
-        if (f == NULL) {
-            expr_free(e);
-            return NULL;
-        }
+    case ET_UNARY:
+        return e->as.unary.op == TT_NOT;
 
-        e = expr_binary(type, e, f);
-        curr = parser_get_token();
+    default:
+        return false;
     }
-    parser_unget_token();
-
-    return e;
 }
 
-Expr *parser_e()
+static bool parser_is_arith(Expr *e)
 {
-    Expr *e = parser_t();
-    if (e == NULL)
-        return NULL;
+    switch (e->type) {
+    case ET_C:
+        return true;
 
-    Token *curr = parser_get_token();
-    while ((token_is_type(curr, TT_PLUS) ||
-            token_is_type(curr, TT_MINUS))) {
-        TokenType type = curr->type;
+    case ET_BINARY:
+        return parser_precedence(e->as.binary.op) >= PREC_SUM;
 
-        Expr *t = parser_t();
-        if (t == NULL) {
-            expr_free(e);
-            return NULL;
-        }
+    case ET_UNARY:
+        return e->as.unary.op == TT_MINUS;
 
-        e = expr_binary(type, e, t);
-        curr = parser_get_token();
+    default:
+        return false;
     }
-    parser_unget_token();
-
-    return e;
 }
 
-static Expr *parser_atom(Expr *left_e)
+static bool parser_check_arith(Expr *e)
 {
-    if (left_e == NULL) {
-        Token *token = parser_get_token();
-        if (token->type == TT_BC) 
-            return expr_bc(token);
-
-        parser_unget_token();
-
-        left_e = parser_e();
-        if (left_e == NULL)
-            return NULL;
-    }
+    if (!parser_is_bool(e))
+        return true;
 
-    Token *op = parser_get_token();
-    if ((!token_is_type(op, TT_GREATER)        &&
-         !token_is_type(op, TT_GREATER_EQUALS) &&
-         !token_is_type(op, TT_LESS)           &&
-         !token_is_type(op, TT_LESS_EQUALS)    &&
-         !token_is_type(op, TT_LOGICAL_EQUALS) &&
-         !token_is_type(op, TT_NOT_EQUALS))) {
-
-        expr_free(left_e);
-        parser_unget_token();
-        parser_log_error(&op->loc,
-                         "expected logical comparison "
-                         "operand after expression."); 
-        return NULL;
-    }
+    parser_log_error(&e->loc, "expected arithmetic operand instead of "
+                     "boolean expression.");
+    return false;
+}
 
-    TokenType type = op->type;
+// e has just been read
+static bool parser_check_bool(Expr *e)
+{
+    if (!parser_is_arith(e))
+        return true;
 
-    Expr *right_e = parser_e();
-    if (right_e == NULL) {
-        expr_free(left_e);
-        return NULL;
-    }
+    Token *next = parser_get_token();
+    parser_unget_token();
+    parser_log_error(&next->loc,
+                     "expected logical comparison "
+                     "operand after expression.");
+    return false;
+}
 
-    return expr_binary(type, left_e, right_e);
+static bool parser_check_operand(Expr *e, Precedence precedence)
+{
+    return precedence >= PREC_COMPARISON 
+        ? parser_check_arith(e) 
+        : parser_check_bool(e);
 }
 
-Expr *parser_bf()
+static Expr *parser_climb(Precedence min);
+
+static Expr *parser_unary()
 {
     Token *curr = parser_get_token();
 
     switch (curr->type) {
+    case TT_MINUS:
+        {
+            uint32_t start = curr->loc.start;
+            Expr *f = parser_unary();
+            if (f == NULL)
+                return NULL;
 
+            if (!parser_check_arith(f))
+                return NULL;
+
+            return expr_unary(TT_MINUS, f, start, true);
+        }
+
+    // Negates a whole comparison, !a < b is !(a < b)
     case TT_NOT:
         {
-            size_t column = curr->loc.column_start;
-            Expr *bf = parser_bf();
+            uint32_t start = curr->loc.start;
+            Expr *bf = parser_climb(PREC_COMPARISON);
             if (bf == NULL)
                 return NULL;
 
-            return expr_unary(TT_NOT, bf, column, true);
+            if (!parser_check_bool(bf))
+                return NULL;
+
+            return expr_unary(TT_NOT, bf, start, true);
         }
 
     case TT_LEFT_PAREN:
         {
-            parser_unget_token();
-            size_t state = parser_state();
-
-            Expr *e = parser_e();
-            if (e != NULL) {
-                parser_drop_state(state);
-                return parser_atom(e);
-            }
-
-            parser_set_state(state);
-            parser_drop_state(state);
-
-            curr = parser_get_token();
             Location left_loc = curr->loc;
-
-            Expr *be = parser_be();
-            if (be == NULL) 
+            Expr *result = parser_climb(PREC_OR);
+            if (result == NULL)
                 return NULL;
 
-            if (parser_expect(TT_RIGHT_PAREN) == NULL) {
-                expr_free(be);
+            Token *r = parser_expect(TT_RIGHT_PAREN);
+            if (r == NULL) {
                 parser_log_info(&left_loc,
                                 "right prarenphesis is here:");
                 return NULL;
             }
 
-            be->loc.column_start = left_loc.column_start;
-            be->loc.column_end = curr->loc.column_start;
-            return be;
+            result->loc.start = left_loc.start;
+            result->loc.end = r->loc.end;
+            return result;
         }
 
-    case TT_NA:
-        {
-            parser_unget_token();
-            size_t state = parser_state();
+    case TT_C:
+        return expr_c(curr);
 
-            Expr *id = parser_id();
-            switch (parser_get_token()->type) {
-            case TT_PLUS:
-            case TT_MINUS:
-            case TT_STAR:
-            case TT_SLASH:
-            case TT_GREATER:
-            case TT_GREATER_EQUALS:
-            case TT_LESS:
-            case TT_LESS_EQUALS:
-            case TT_LOGICAL_EQUALS:
-            case TT_NOT_EQUALS:
-                parser_set_state(state);
-                parser_drop_state(state);
-                expr_free(id);
-                return parser_atom(NULL);
-
-            default:
-                parser_drop_state(state);
-                parser_unget_token();
-                return id;
-            }
-        }
+    case TT_BC:
+        return expr_bc(curr);
+
+    case TT_NA:
+        parser_unget_token();
+        return parser_id();
 
     default:
         parser_unget_token();
-        return parser_atom(NULL);
+        parser_log_error(&curr->loc,
+                         "expected factor instead of \"%s\".",
+                         str_chars(curr->lexeme));
+        return NULL;
     }
 }
 
-Expr *parser_bt()
+// Reads operators binding at least as tightly as min. Each token is read
+// once, whether the expression turns out arithmetic or boolean.
+static Expr *parser_climb(Precedence min)
 {
-    Expr *e = parser_bf();
+    Expr *e = parser_unary();
     if (e == NULL)
         return NULL;
 
-    Token *curr = parser_get_token();
-    while (curr->type == TT_LOGICAL_AND) {
-        TokenType type = curr->type;
+    while (true) {
+        TokenType type = parser_get_token()->type;
+        Precedence precedence = parser_precedence(type);
+        parser_unget_token();
+
+        if (precedence == PREC_NONE || precedence < min)
+            return e;
 
-        Expr *f = parser_bf();
-        if (f == NULL) {
-            expr_free(e);
+        if (!parser_check_operand(e, precedence))
             return NULL;
-        }
 
-        e = expr_binary(type, e, f);
-        curr = parser_get_token();
+        parser_get_token();
+
+        // Comparisons do not chain, a < b < c compares a boolean
+        Expr *right = parser_climb(precedence + 1);
+        if (right == NULL || !parser_check_operand(right, precedence))
+            return NULL;
+
+        e = expr_binary(type, e, right);
     }
+}
+
+Expr *parser_e()
+{
+    Expr *e = parser_climb(PREC_SUM);
+    if (e != NULL && !parser_check_arith(e))
+        return NULL;
 
-    parser_unget_token();
     return e;
 }
 
 Expr *parser_be()
 {
-    Expr *e = parser_bt();
-    if (e == NULL)
+    Expr *e = parser_climb(PREC_OR);
+    if (e != NULL && !parser_check_bool(e))
         return NULL;
 
-    Token *curr = parser_get_token();
-    while (curr->type == TT_LOGICAL_OR) {
-        TokenType type = curr->type;
-
-        Expr *t = parser_bt();
-        if (t == NULL) {
-            expr_free(e);
-            return NULL;
-        }
-
-        e = expr_binary(type, e, t);
-        curr = parser_get_token();
-    }
-
-    parser_unget_token();
     return e;
 }
 
@@ -478,46 +433,20 @@ static Expr *parser_cc_be_e()
         return expr_cc(curr);
 
     parser_unget_token();
-    size_t state = parser_state();
-    Expr *result = parser_e();
-    if (result != NULL) {
-        switch (parser_get_token()->type) {
-        case TT_GREATER:
-        case TT_GREATER_EQUALS:
-        case TT_LESS:
-        case TT_LESS_EQUALS:
-        case TT_LOGICAL_EQUALS:
-        case TT_NOT_EQUALS:
-            parser_set_state(state);
-            parser_drop_state(state);
-            expr_free(result);
-            return parser_be();
-
-        default:
-            parser_drop_state(state);
-            parser_unget_token();
-            return result;
-        }
-    }
-
-    parser_set_state(state);
-    parser_drop_state(state);
-
-    return parser_be();
+    return parser_climb(PREC_OR);
 }
 
 static Expr **parser_args()
 {
     size_t allocated = 8;
     size_t size = 0;
-    Expr **result = malloc(allocated * sizeof *result);
+    Expr **result = ast_alloc(allocated * sizeof *result);
+    result[0] = NULL;
 
     do {
         Expr *e = parser_cc_be_e();
-        if (e == NULL) {
-            exprs_free(result);
+        if (e == NULL)
             return NULL;
-        }
 
         result[size] = e;
         result[++size] = NULL;
@@ -525,13 +454,13 @@ static Expr **parser_args()
         if (size < allocated - 1)
             continue;
 
+        result = ast_realloc(result, allocated * sizeof *result,
+                             2 * allocated * sizeof *result);
         allocated *= 2;
-        result = realloc(result, allocated * sizeof *result);
 
     } while (parser_get_token()->type == TT_COMMA);
     parser_unget_token();
 
-    result = realloc(result, (size + 1) * sizeof *result);
     return result;
 }
 
@@ -539,7 +468,8 @@ static Stmt **parser_stmts()
 {
     size_t allocated = 8;
     size_t size = 0;
-    Stmt **result = malloc(allocated * sizeof *result);
+    Stmt **result = ast_alloc(allocated * sizeof *result);
+    result[0] = NULL;
 
     do {
         Token *t = parser_get_token();
@@ -554,7 +484,6 @@ static Stmt **parser_stmts()
                 continue;
 
             parser_unget_token();
-            stmts_free(result);
             return NULL;
         }
 
@@ -564,12 +493,12 @@ static Stmt **parser_stmts()
         if (size < allocated - 1)
             continue;
 
+        result = ast_realloc(result, allocated * sizeof *result,
+                             2 * allocated * sizeof *result);
         allocated *= 2;
-        result = realloc(result, allocated * sizeof *result);
     } while (parser_get_token()->type == TT_SEMICOLON);
     parser_unget_token();
 
-    result = realloc(result, (size + 1) * sizeof *result);
     return result;
 }
 
@@ -581,92 +510,71 @@ Stmt *parser_stmt()
 
     case TT_IF:
         {
-            size_t start_column = first->loc.column_start;
+            uint32_t start = first->loc.start;
             Expr *be = parser_be();
             if (be == NULL)
                 return NULL;
 
             Token *l_brace = parser_expect(TT_LEFT_BRACE);
-            if (l_brace == NULL) {
-                expr_free(be);
+            if (l_brace == NULL)
                 return NULL;
-            }
             Location l_brace_loc = l_brace->loc;
 
             Stmt **then_stmts = parser_stmts();
-            if (then_stmts == NULL) {
-                expr_free(be);
+            if (then_stmts == NULL)
                 return NULL;
-            }
 
             if (parser_expect(TT_RIGHT_BRACE) == NULL) {
                 parser_log_info(&l_brace_loc, "left brace is here:");
-                expr_free(be);
-                stmts_free(then_stmts);
                 return NULL;
             }
 
             Token *else_token = parser_get_token();
             if (else_token->type != TT_ELSE) {
                 parser_unget_token();
-                return stmt_if(be, then_stmts, NULL, start_column);
+                return stmt_if(be, then_stmts, NULL, start);
             }
 
             Token *else_brace = parser_expect(TT_LEFT_BRACE);
-            if (else_brace == NULL) {
-                expr_free(be);
-                stmts_free(then_stmts);
+            if (else_brace == NULL)
                 return NULL;
-            }
             Location else_brace_loc = else_brace->loc;
 
             Stmt **else_stmts = parser_stmts();
-            if (else_stmts == NULL) {
-                expr_free(be);
-                stmts_free(then_stmts);
+            if (else_stmts == NULL)
                 return NULL;
-            }
 
             if (parser_expect(TT_RIGHT_BRACE) == NULL) {
                 parser_log_info(&else_brace_loc, "left brace is here:");
-                expr_free(be);
-                stmts_free(then_stmts);
-                stmts_free(else_stmts);
                 return NULL;
             }
 
-            return stmt_if(be, then_stmts, else_stmts, start_column);
+            return stmt_if(be, then_stmts, else_stmts, start);
         }
 
     case TT_WHILE:
         {
-            size_t start_column = first->loc.column_start;
+            uint32_t start = first->loc.start;
             Expr *be = parser_be();
             if (be == NULL)
                 return NULL;
 
             Token *l_brace = parser_expect(TT_LEFT_BRACE);
-            if (l_brace == NULL) {
-                expr_free(be);
+            if (l_brace == NULL)
                 return NULL;
-            }
 
             Location l_brace_loc = l_brace->loc;
 
             Stmt **stmts = parser_stmts();
-            if (stmts == NULL) {
-                expr_free(be);
+            if (stmts == NULL)
                 return NULL;
-            }
 
             if (parser_expect(TT_RIGHT_BRACE) == NULL) {
                 parser_log_info(&l_brace_loc, "left brace is here:");
-                expr_free(be);
-                stmts_free(stmts); 
                 return NULL;
             }
 
-            return stmt_while(be, stmts, start_column);
+            return stmt_while(be, stmts, start);
         }
 
     default:
@@ -676,60 +584,53 @@ Stmt *parser_stmt()
             if (id == NULL)
                 return NULL;
 
-            if (parser_expect(TT_EQUALS) == NULL) {
-                expr_free(id);
+            if (parser_expect(TT_EQUALS) == NULL)
                 return NULL;
-            }
 
             Token *next = parser_get_token();
             if (next->type == TT_NEW) {
                 Token *na = parser_expect(TT_NA);
-                if (na == NULL) {
-                    expr_free(id);
+                if (na == NULL)
                     return NULL;
-                }
 
                 Token *star = parser_expect(TT_STAR);
-                if (star == NULL) {
-                    expr_free(id);
+                if (star == NULL)
                     return NULL;
-                }
 
-                return stmt_new(id, na, star->loc.column_end);
+                return stmt_new(id, na, star->loc.end);
             }
 
             Token *paren = parser_get_token();
             if (next->type == TT_NA && paren->type == TT_LEFT_PAREN) {
+                // The arguments may read any number of tokens
+                Token callee = *next;
+                Symbol *sym = parser_resolve(function_syms, &callee, true);
+
                 Token *right_paren = parser_get_token();
                 if (right_paren->type == TT_RIGHT_PAREN) 
-                    return stmt_funcall(id, next, NULL, right_paren->loc.column_end);
+                    return stmt_funcall(id, &callee, sym, NULL, 
+                                        right_paren->loc.end);
 
                 parser_unget_token();
 
                 Expr **args = parser_args();
-                if (args == NULL) {
-                    expr_free(id);
+                if (args == NULL)
                     return NULL;
-                }
 
                 right_paren = parser_expect(TT_RIGHT_PAREN);
-                if (right_paren == NULL) {
-                    expr_free(id);
-                    exprs_free(args);
+                if (right_paren == NULL)
                     return NULL;
-                }
 
-                return stmt_funcall(id, next, args, right_paren->loc.column_end);
+                return stmt_funcall(id, &callee, sym, args, 
+                                    right_paren->loc.end);
             }
 
             parser_unget_token();
             parser_unget_token();
 
             Expr *right = parser_cc_be_e();
-            if (right == NULL) {
-                expr_free(id);
+            if (right == NULL)
                 return NULL;
-            }
 
             return stmt_assign(id, right);
         }
@@ -753,7 +654,7 @@ Type *parser_ty(bool should_exist)
 
             if (should_exist) {
                 parser_log_error(&curr->loc, "unkown type: %s", 
-                                 curr->lexeme);
+                                 str_chars(curr->lexeme));
                 return NULL;
             }
 
@@ -762,7 +663,7 @@ Type *parser_ty(bool should_exist)
 
     default:
         parser_log_error(&curr->loc, "expected type but got: %s", 
-                         curr->lexeme);
+                         str_chars(curr->lexeme));
         return NULL;
     }
 }
@@ -827,7 +728,7 @@ bool parser_tyd()
         if (type_struct(name->lexeme, fields, fields_count) == NULL) {
             parser_log_error(&name->loc, 
                              "type with name %s already exists", 
-                             name->lexeme); 
+                             str_chars(name->lexeme)); 
             return false;    
         }
 
@@ -852,7 +753,7 @@ bool parser_tyd()
             if (dig->is_null) {
                 parser_log_error(&dig->loc, 
                                  "expected digit but got: %s", 
-                                 dig->lexeme);
+                                 str_chars(dig->lexeme));
                 return false;
             }
 
@@ -874,7 +775,7 @@ bool parser_tyd()
             if (type_array(name->lexeme, type, elements) == NULL) {
                 parser_log_error(&name->loc, 
                                  "type with name %s already exists", 
-                                 name->lexeme); 
+                                 str_chars(name->lexeme)); 
                 return false;    
             }
 
@@ -890,7 +791,7 @@ bool parser_tyd()
             if (type_pointer(name->lexeme, type) == NULL) {
                 parser_log_error(&name->loc, 
                                  "type with name %s already exists", 
-                                 name->lexeme); 
+                                 str_chars(name->lexeme)); 
                 return false;    
             }
 
@@ -899,7 +800,7 @@ bool parser_tyd()
 
     default:
         parser_log_error(&op->loc, "unexpected %s", 
-                         op->lexeme); 
+                         str_chars(op->lexeme)); 
         return false;
     }
 }
@@ -947,8 +848,7 @@ bool parser_global_vad()
     if (!symtable_add(global_syms, sym)) {
         parser_log_error(&name->loc, 
                          "variable with name %s already exists", 
-                         name->lexeme);
-        free(sym);
+                         str_chars(name->lexeme));
         return false;
     }
 
@@ -972,7 +872,7 @@ static bool parser_is_type(Token *na)
     }
 }
 
-static int parser_local_vads(SymTable *local)
+static int parser_local_vads()
 {
     int count = 0;
     do {
@@ -991,7 +891,7 @@ static int parser_local_vads(SymTable *local)
         if (!parser_is_type(type)) {
             parser_log_error(&type->loc,
                              "unknown type: %s",
-                             type->lexeme);
+                             str_chars(type->lexeme));
             return -1;
         }
 
@@ -1001,11 +901,10 @@ static int parser_local_vads(SymTable *local)
                                     type_get(type->lexeme),
                                     SS_LOCAL,
                                     &name->loc); 
-        if (!symtable_add(local, sym)) {
+        if (!symtable_add(global_syms, sym)) {
             parser_log_error(&name->loc, 
                              "variable with name %s already exists", 
-                             name->lexeme);
-            free(sym);
+                             str_chars(name->lexeme));
             return -1;
         }
 
@@ -1029,13 +928,24 @@ Function *parser_fud()
     if (name_token == NULL)
         return NULL;
 
-    char *fun_name = name_token->lexeme;
+    StrId fun_name = name_token->lexeme;
+
+    // Bound before the body, so calls in it resolve to the function itself
+    Symbol *fun_sym = function_symbol_create(fun_name, NULL, 
+                                             &name_token->loc);
+    if (!symtable_add(function_syms, fun_sym)) {
+        parser_log_error(&name_token->loc, 
+                         "function with name %s already exists", 
+                         str_chars(fun_name));
+        return NULL;
+    }
 
     // Arguments
     if (parser_expect(TT_LEFT_PAREN) == NULL) 
         return NULL;
 
-    SymTable *local = symtable_create(global_syms);
+    // Arguments and locals go in a scope of their own
+    symtable_enter(global_syms);
 
     Type **arg_types = NULL;
     size_t arg_count = 0;
@@ -1068,11 +978,10 @@ Function *parser_fud()
                                             type,
                                             SS_LOCAL,
                                             &name->loc); 
-                if (!symtable_add(local, new)) {
+                if (!symtable_add(global_syms, new)) {
                     parser_log_error(&name->loc, 
                                      "parameter with name %s already exists",
-                                     name->lexeme);
-                    free(new);
+                                     str_chars(name->lexeme));
                     goto clean_arg_types;
                 }
 
@@ -1088,7 +997,7 @@ Function *parser_fud()
             if (t->type != TT_RIGHT_PAREN) {
                 parser_log_error(&t->loc,
                                  "expected \")\" but got %s",
-                                 t->lexeme);
+                                 str_chars(t->lexeme));
                 goto clean_arg_types;
             }
 
@@ -1098,7 +1007,7 @@ Function *parser_fud()
 
     default:
         parser_log_error(&token->loc, "unexpected %s", 
-                         token->lexeme);
+                         str_chars(token->lexeme));
         goto clean_symtable;
     } 
 
@@ -1106,7 +1015,7 @@ Function *parser_fud()
     if (parser_expect(TT_LEFT_BRACE) == NULL) 
         goto clean_arg_types;
 
-    int local_vads_result = parser_local_vads(local);
+    int local_vads_result = parser_local_vads();
     if (local_vads_result == -1 ||
         (local_vads_result > 0 && parser_expect(TT_SEMICOLON) == NULL))
         goto clean_arg_types;
@@ -1120,41 +1029,79 @@ Function *parser_fud()
     if (t->type != TT_RETURN) {
         stmts = parser_stmts();
         if (parser_expect(TT_SEMICOLON) == NULL) 
-            goto clean_symtable;
+            goto clean_arg_types;
     }
 
     // Return statement
     t = parser_expect(TT_RETURN);
     if (t == NULL) 
-        goto clean_stmts;
+        goto clean_arg_types;
 
-    size_t start_column = t->loc.column_start;
+    uint32_t start = t->loc.start;
 
     Expr *e = parser_cc_be_e();
     if (e == NULL)
-        goto clean_stmts;
+        goto clean_arg_types;
 
-    Stmt *return_stmt = stmt_return(e, start_column);
+    Stmt *return_stmt = stmt_return(e, start);
 
     if (parser_expect(TT_RIGHT_BRACE) == NULL)
-        goto clean_all;
-
-    return function_create(fun_name, arg_types, arg_count, local, 
-                           stmts, return_type, return_stmt);
+        goto clean_arg_types;
 
-clean_all:
-    stmt_free(return_stmt);
+    size_t locals_count;
+    Symbol **locals = symtable_leave(global_syms, &locals_count);
 
-clean_stmts:
-    if (stmts != NULL)
-        stmts_free(stmts); 
+    fun_sym->function = function_create(fun_name, arg_types, arg_count, 
+                                        locals, locals_count, stmts, 
+                                        return_type, return_stmt);
+    return fun_sym->function;
 
 clean_arg_types:
     if (arg_types != NULL)
         free(arg_types);
 
 clean_symtable:
-    symtable_destroy(local);
+    symtable_leave(global_syms, NULL);
 
     return NULL;
 }
+
+// Global variables, each followed by a semicolon, up to the first function
+// or the end of the input
+static bool parser_global_vads()
+{
+    while (true) {
+        // Looks at the next PARSER_LOOK_AHEAD tokens, which can always be
+        // put back
+        bool is_end = parser_get_token()->type == TT_EOF;
+        parser_get_token();
+        bool is_function = parser_get_token()->type == TT_LEFT_PAREN;
+        for (size_t i = 0; i < PARSER_LOOK_AHEAD; i++)
+            parser_unget_token();
+
+        if (is_function || is_end)
+            return true;
+
+        if (!parser_global_vad() || parser_expect(TT_SEMICOLON) == NULL)
+            return false;
+    }
+}
+
+Function *parser_prog()
+{
+    if (!parser_tyds())
+        return NULL;
+
+    if (parser_get_token()->type != TT_SEMICOLON)
+        parser_unget_token();
+
+    if (!parser_global_vads())
+        return NULL;
+
+    // Declarations alone, such as a prelude to emit an interface for
+    if (parser_get_token()->type == TT_EOF)
+        return NULL;
+
+    parser_unget_token();
+    return parser_fud();
+}
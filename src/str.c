@@ -1,46 +1,322 @@
 #include "../include/str.h"
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
-String *strings[STRING_BUCKETS_SIZE] = {NULL};
+#define STR_CACHE_LINE 64
 
-char *str_get(char *str, size_t len)
+// Every interned string is an entry, its ID is its index across segments
+typedef struct StringEntry {
+    char *str;
+    uint64_t hash;
+} StringEntry;
+
+typedef struct StringBlock StringBlock;
+
+struct StringBlock {
+    StringBlock *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+typedef struct StringTable StringTable;
+
+// Open addressing with linear probing, replaced by one twice its size past
+// 3/4 full. A slot packs the low half of the hash over ID + 1 (0 when
+// empty), which is all growing needs and filters out nearly every mismatch
+// before the entry is looked at.
+struct StringTable {
+    size_t allocated;
+    // Tables this one replaced, readers may still be probing them
+    StringTable *retired;
+    _Atomic uint64_t slots[];
+};
+
+// Lookups never lock, they only probe the current table of the shard
+// picked by the top bits of the hash. A miss is retried under the shard's 
+// lock before inserting.
+typedef struct StringShard {
+    _Alignas(STR_CACHE_LINE) pthread_mutex_t lock;
+    _Atomic(StringTable *) table;
+    size_t count;
+    StringBlock *blocks;
+} StringShard;
+
+static StringShard shards[STR_SHARDS] = {
+    [0 ... STR_SHARDS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+};
+
+static _Atomic(StringEntry *) entry_segments[STR_ENTRY_SEGMENTS];
+static atomic_uint entries_count;
+static pthread_mutex_t segments_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void str_init(char **reserved, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        str_intern_null_term(reserved[i]);
+}
+
+void str_deinit()
 {
-    size_t index = str_hash(str) & (STRING_BUCKETS_SIZE - 1);
+    for (size_t i = 0; i < STR_SHARDS; i++) {
+        StringShard *shard = &shards[i];
+
+        while (shard->blocks != NULL) {
+            StringBlock *next = shard->blocks->next;
+            free(shard->blocks);
+            shard->blocks = next;
+        }
 
-    String *curr = strings[index];
-    while (curr != NULL) {
-        if (strncmp(curr->str, str, len) == 0)
-            return curr->str;
-        curr = curr->next;
+        StringTable *table = atomic_load(&shard->table);
+        while (table != NULL) {
+            StringTable *retired = table->retired;
+            free(table);
+            table = retired;
+        }
+
+        atomic_store(&shard->table, NULL);
+        shard->count = 0;
     }
 
-    size_t len_in_bytes = (len + 1) * sizeof *str;
-    char *s = malloc(len_in_bytes);
-    memcpy(s, str, len_in_bytes);
-    s[len] = '\0';
+    for (size_t i = 0; i < STR_ENTRY_SEGMENTS; i++) {
+        free(atomic_load(&entry_segments[i]));
+        atomic_store(&entry_segments[i], NULL);
+    }
 
-    curr = malloc(sizeof *curr);
-    curr->str = s;
-    curr->len = len;
-    curr->next = strings[index];
-    strings[index] = curr;
+    atomic_store(&entries_count, 0);
+}
+
+static inline StringEntry *str_entry(StrId id, bool allocate)
+{
+    size_t n = id / STR_ENTRY_SEGMENT_SIZE + 1;
+    unsigned segment = 63 - __builtin_clzll(n);
+    size_t index = id - STR_ENTRY_SEGMENT_SIZE * ((1ull << segment) - 1);
+
+    StringEntry *entries = atomic_load_explicit(&entry_segments[segment],
+                                                memory_order_acquire);
+    if (entries == NULL && allocate) {
+        pthread_mutex_lock(&segments_lock);
+
+        entries = atomic_load_explicit(&entry_segments[segment],
+                                       memory_order_relaxed);
+        if (entries == NULL) {
+            entries = malloc((STR_ENTRY_SEGMENT_SIZE << segment) 
+                             * sizeof *entries);
+            atomic_store_explicit(&entry_segments[segment], entries,
+                                  memory_order_release);
+        }
+
+        pthread_mutex_unlock(&segments_lock);
+    }
+
+    return &entries[index];
+}
+
+static char *str_copy(StringShard *shard, char *str, size_t len)
+{
+    // Keeps every length header 4-byte aligned
+    size_t size = (sizeof(uint32_t) + len + 1 + 3) & ~(size_t) 3;
+
+    StringBlock *block = shard->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = size > STR_ARENA_BLOCK_SIZE 
+            ? size : STR_ARENA_BLOCK_SIZE;
+
+        block = malloc(sizeof *block + block_size);
+        block->next = shard->blocks;
+        block->size = block_size;
+        block->used = 0;
+        shard->blocks = block;
+    }
+
+    uint32_t *header = (uint32_t *) (block->data + block->used);
+    block->used += size;
+
+    char *s = (char *) (header + 1);
+    *header = len;
+    memcpy(s, str, len);
+    s[len] = '\0';
 
     return s;
 }
 
-char *str_get_null_term(char *str)
+static bool str_find(StringTable *table, char *str, size_t len, 
+                     size_t hash, StrId *result)
+{
+    if (table == NULL)
+        return false;
+
+    size_t mask = table->allocated - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        uint64_t slot = atomic_load_explicit(&table->slots[i],
+                                             memory_order_acquire);
+        if (slot == 0)
+            return false;
+
+        if ((uint32_t) (slot >> 32) != (uint32_t) hash)
+            continue;
+
+        StrId id = (uint32_t) slot - 1;
+        StringEntry *entry = str_entry(id, false);
+        if (entry->hash == hash && str_len(entry->str) == len && 
+            memcmp(entry->str, str, len) == 0) {
+            *result = id;
+            return true;
+        }
+    }
+}
+
+static _Atomic uint64_t *str_free_slot(StringTable *table, size_t hash)
 {
-    return str_get(str, strlen(str));
+    size_t mask = table->allocated - 1;
+    size_t index = hash & mask;
+
+    while (atomic_load_explicit(&table->slots[index], 
+                                memory_order_relaxed) != 0)
+        index = (index + 1) & mask;
+
+    return &table->slots[index];
+}
+
+// Called with the shard locked
+static StringTable *str_grow(StringShard *shard)
+{
+    StringTable *old = atomic_load_explicit(&shard->table, 
+                                            memory_order_relaxed);
+    size_t allocated = old == NULL 
+        ? STR_TABLE_INITIAL_SIZE : old->allocated * 2;
+
+    StringTable *table = calloc(1, sizeof *table 
+                                + allocated * sizeof *table->slots);
+    table->allocated = allocated;
+    table->retired = old;
+
+    for (size_t i = 0; old != NULL && i < old->allocated; i++) {
+        uint64_t slot = atomic_load_explicit(&old->slots[i], 
+                                             memory_order_relaxed);
+        if (slot != 0)
+            atomic_store_explicit(str_free_slot(table, slot >> 32), slot,
+                                  memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&shard->table, table, memory_order_release);
+    return table;
+}
+
+static StrId str_insert(StringShard *shard, char *str, size_t len, 
+                        size_t hash)
+{
+    StrId id;
+    StringTable *table = atomic_load_explicit(&shard->table, 
+                                              memory_order_relaxed);
+
+    // Someone may have inserted it since the lock-free lookup
+    if (str_find(table, str, len, hash, &id))
+        return id;
+
+    if (table == NULL || (shard->count + 1) * 4 > table->allocated * 3)
+        table = str_grow(shard);
+
+    id = atomic_fetch_add_explicit(&entries_count, 1, memory_order_relaxed);
+
+    StringEntry *entry = str_entry(id, true);
+    entry->str = str_copy(shard, str, len);
+    entry->hash = hash;
+    shard->count++;
+
+    // Publishes the entry along with the slot
+    atomic_store_explicit(str_free_slot(table, hash), 
+                          (uint64_t) (uint32_t) hash << 32 | (id + 1),
+                          memory_order_release);
+
+    return id;
+}
+
+StrId str_intern(char *str, size_t len)
+{
+    return str_intern_hashed(str, len, str_hash_len(str, len));
+}
+
+StrId str_intern_hashed(char *str, size_t len, size_t hash)
+{
+    StringShard *shard = &shards[(hash >> 56) & (STR_SHARDS - 1)];
+    StrId id;
+
+    StringTable *table = atomic_load_explicit(&shard->table, 
+                                              memory_order_acquire);
+    if (str_find(table, str, len, hash, &id))
+        return id;
+
+    pthread_mutex_lock(&shard->lock);
+    id = str_insert(shard, str, len, hash);
+    pthread_mutex_unlock(&shard->lock);
+
+    return id;
+}
+
+StrId str_intern_null_term(char *str)
+{
+    return str_intern(str, strlen(str));
+}
+
+char *str_chars(StrId id)
+{
+    return str_entry(id, false)->str;
+}
+
+void str_stats(StrStats *stats)
+{
+    *stats = (StrStats) { .count = atomic_load(&entries_count) };
+
+    for (size_t i = 0; i < STR_SHARDS; i++) {
+        StringShard *shard = &shards[i];
+        pthread_mutex_lock(&shard->lock);
+
+        StringTable *table = atomic_load(&shard->table);
+        for (bool is_current = true; table != NULL; is_current = false) {
+            size_t bytes = sizeof *table 
+                + table->allocated * sizeof *table->slots;
+            if (is_current)
+                stats->table_bytes += bytes;
+            else
+                stats->retired_bytes += bytes;
+
+            table = table->retired;
+        }
+
+        for (StringBlock *block = shard->blocks; block != NULL; 
+             block = block->next)
+            stats->string_bytes += sizeof *block + block->size;
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    for (size_t i = 0; i < STR_ENTRY_SEGMENTS; i++) {
+        if (atomic_load(&entry_segments[i]) != NULL) {
+            stats->entry_bytes += (STR_ENTRY_SEGMENT_SIZE << i) 
+                * sizeof(StringEntry);
+        }
+    }
 }
 
-// Source: http://www.cse.yorku.ca/~oz/hash.html
 size_t str_hash(char *str)
 {
-    size_t hash = 5381;
-    int c;
+    return str_hash_len(str, strlen(str));
+}
+
+size_t str_hash_len(char *str, size_t len)
+{
+    size_t hash = STR_HASH_SEED;
 
-    while ((c = *str++))
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+    for (size_t i = 0; i < len; i += 8) {
+        uint64_t word = 0;
+        for (size_t j = 0; j < 8 && i + j < len; j++)
+            word |= (uint64_t) (unsigned char) str[i + j] << (8 * j);
+
+        hash = str_hash_word(hash, word);
+    }
 
-    return hash;
+    return str_hash_finish(hash, len);
 }
@@ -1,29 +1,40 @@
 #include "../include/symbol_table.h"
 
+typedef struct SymbolBlock SymbolBlock;
+
+struct SymbolBlock {
+    SymbolBlock *next;
+    size_t used;
+    Symbol symbols[SYMBOL_BLOCK_SIZE];
+};
+
+static SymbolBlock *symbol_blocks = NULL;
+
 SymTable *global_syms = NULL;
 SymTable *function_syms = NULL;
 
-static Symbol *symtable_get_locally(SymTable *table, char *name)
+static Symbol *symbol_new(StrId name)
 {
-    size_t index = str_hash(name) & (SYMTABLE_SIZE - 1);
-    
-    for (Symbol *curr = table->symbols[index]; 
-         curr != NULL; 
-         curr = curr->next) { 
-        if (curr->name == name)
-            return curr;
+    if (symbol_blocks == NULL || symbol_blocks->used == SYMBOL_BLOCK_SIZE) {
+        SymbolBlock *block = malloc(sizeof *block);
+        block->next = symbol_blocks;
+        block->used = 0;
+        symbol_blocks = block;
     }
 
-    return NULL;
+    Symbol *result = &symbol_blocks->symbols[symbol_blocks->used++];
+    memset(result, 0, sizeof *result);
+    result->name = name;
+
+    return result;
 }
 
-Symbol *symbol_create(char *name, 
+Symbol *symbol_create(StrId name, 
                       Type *type, 
                       SymScope scope, 
                       Location *loc_src)
 {
-    Symbol *result = calloc(1, sizeof *result);
-    result->name = name;
+    Symbol *result = symbol_new(name);
     result->type = type;
     result->scope = scope;
 
@@ -33,12 +44,11 @@ Symbol *symbol_create(char *name,
     return result;
 }
 
-Symbol *function_symbol_create(char *name, 
+Symbol *function_symbol_create(StrId name, 
                                Function *function, 
                                Location *loc_src)
 {
-    Symbol *result = calloc(1, sizeof *result);
-    result->name = name;
+    Symbol *result = symbol_new(name);
     result->scope = SS_GLOBAL;
     result->function = function;
     memcpy(&result->loc, loc_src, sizeof *loc_src);
@@ -47,58 +57,103 @@ Symbol *function_symbol_create(char *name,
 
 void symtable_init()
 {
-    global_syms = symtable_create(NULL);
-    function_syms = symtable_create(NULL);
+    global_syms = symtable_create();
+    function_syms = symtable_create();
 }
 
 void symtable_deinit()
 {
     symtable_destroy(global_syms);
     symtable_destroy(function_syms);
+
+    while (symbol_blocks != NULL) {
+        SymbolBlock *next = symbol_blocks->next;
+        free(symbol_blocks);
+        symbol_blocks = next;
+    }
 }
 
-SymTable *symtable_create(SymTable *prev)
+SymTable *symtable_create()
 {
-    SymTable *result = calloc(1, sizeof *result);
-    result->prev = prev;
-
-    return result;
+    return calloc(1, sizeof(SymTable));
 }
 
 void symtable_destroy(SymTable *table)
 {
-    for (size_t i = 0; i < SYMTABLE_SIZE; i++) {
-        Symbol *curr = table->symbols[i];
-        while (curr != NULL) {
-            Symbol *tmp = curr;
-            curr = curr->next;
-            free(tmp);
-        }
+    free(table->bindings);
+    free(table->log);
+    free(table->scopes);
+    free(table);
+}
+
+void symtable_enter(SymTable *table)
+{
+    if (table->depth == table->scopes_allocated) {
+        table->scopes_allocated = table->scopes_allocated == 0 
+            ? 8 : table->scopes_allocated * 2;
+        table->scopes = realloc(table->scopes, 
+                                table->scopes_allocated * sizeof *table->scopes);
     }
 
-    free(table);
+    table->scopes[table->depth++] = table->log_size;
+}
+
+Symbol **symtable_leave(SymTable *table, size_t *count)
+{
+    size_t start = table->scopes[--table->depth];
+    Symbol **result = NULL;
+
+    if (count != NULL) {
+        *count = table->log_size - start;
+        result = malloc(*count * sizeof *result);
+        memcpy(result, table->log + start, *count * sizeof *result);
+    }
+
+    // Undone newest first, so a name added twice gets its oldest binding back
+    while (table->log_size > start) {
+        Symbol *sym = table->log[--table->log_size];
+        table->bindings[sym->name] = sym->shadowed;
+    }
+
+    return result;
 }
 
 bool symtable_add(SymTable *table, Symbol *sym)
 {
-    if (symtable_get_locally(table, sym->name) != NULL)
+    Symbol *shadowed = symtable_get(table, sym->name);
+    if (shadowed != NULL && shadowed->depth == table->depth)
         return false;
-    
-    size_t index = str_hash(sym->name) & (SYMTABLE_SIZE - 1);
-    sym->next = table->symbols[index];
-    table->symbols[index] = sym;
+
+    if (sym->name >= table->bindings_allocated) {
+        size_t allocated = table->bindings_allocated == 0 
+            ? 64 : table->bindings_allocated;
+        while (allocated <= sym->name)
+            allocated *= 2;
+
+        table->bindings = realloc(table->bindings, 
+                                  allocated * sizeof *table->bindings);
+        memset(table->bindings + table->bindings_allocated, 0,
+               (allocated - table->bindings_allocated) 
+               * sizeof *table->bindings);
+        table->bindings_allocated = allocated;
+    }
+
+    if (table->log_size == table->log_allocated) {
+        table->log_allocated = table->log_allocated == 0 
+            ? 64 : table->log_allocated * 2;
+        table->log = realloc(table->log, 
+                             table->log_allocated * sizeof *table->log);
+    }
+
+    sym->depth = table->depth;
+    sym->shadowed = shadowed;
+    table->bindings[sym->name] = sym;
+    table->log[table->log_size++] = sym;
+
     return true;
 }
 
-Symbol *symtable_get(SymTable *table, char *name)
+Symbol *symtable_get(SymTable *table, StrId name)
 {
-    SymTable *curr = table;
-    while (curr != NULL) {
-        Symbol *sym = symtable_get_locally(curr, name);
-        if (sym != NULL)
-            return sym;
-        curr = curr->prev;
-    }
-
-    return NULL;
+    return name < table->bindings_allocated ? table->bindings[name] : NULL;
 }
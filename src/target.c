@@ -0,0 +1,48 @@
+#include <string.h>
+#include "../include/target.h"
+
+// i386 System V
+const Target target_x86 = {
+    .name = "x86",
+    .sizes  = { 4, 1, 1, 4, 4 },
+    .aligns = { 4, 1, 1, 4, 4 },
+    .stack_align = 16,
+    .vector_width = 16
+};
+
+// x86-64 System V, vectors limited to the SSE2 every such CPU has
+const Target target_x86_64 = {
+    .name = "x86-64",
+    .sizes  = { 4, 1, 1, 4, 8 },
+    .aligns = { 4, 1, 1, 4, 8 },
+    .stack_align = 16,
+    .vector_width = 16
+};
+
+// DLX, a 32-bit load/store RISC machine without vector registers, so the
+// widest it moves at once is a 4-byte word
+const Target target_dlx = {
+    .name = "dlx",
+    .sizes  = { 4, 1, 1, 4, 4 },
+    .aligns = { 4, 1, 1, 4, 4 },
+    .stack_align = 4,
+    .vector_width = 4
+};
+
+const Target *target_default = &target_x86_64;
+
+static const Target *targets[] = {
+    &target_x86,
+    &target_x86_64,
+    &target_dlx
+};
+
+const Target *target_find(char *name)
+{
+    for (size_t i = 0; i < sizeof targets / sizeof *targets; i++) {
+        if (!strcmp(targets[i]->name, name))
+            return targets[i];
+    }
+
+    return NULL;
+}
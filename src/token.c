@@ -7,21 +7,31 @@ char *token_strings[] = {
     "return", "typedef", "while", "new" 
 };
 
+void token_init(Token *token, TokenType type, Location *loc_src)
+{
+    token_init_with_lexeme(token, type, loc_src, type);
+}
+
+void token_init_with_lexeme(Token *token, TokenType type, 
+                            Location *loc_src, StrId lexeme)
+{
+    memset(token, 0, sizeof *token);
+    token->type = type;
+    memcpy(&token->loc, loc_src, sizeof *loc_src);
+    token->lexeme = lexeme;
+}
+
 Token *token_create(TokenType type, Location *loc_src)
 {
-    Token *result = calloc(1, sizeof *result);
-    result->type = type;
-    memcpy(&result->loc, loc_src, sizeof *loc_src);
-    result->lexeme = token_strings[type];
+    Token *result = malloc(sizeof *result);
+    token_init(result, type, loc_src);
     return result;
 }
 
-Token *token_create_with_lexeme(TokenType type, Location *loc_src, char *lexeme)
+Token *token_create_with_lexeme(TokenType type, Location *loc_src, StrId lexeme)
 {
-    Token *result = calloc(1, sizeof *result);
-    result->type = type;
-    memcpy(&result->loc, loc_src, sizeof *loc_src);
-    result->lexeme = lexeme;
+    Token *result = malloc(sizeof *result);
+    token_init_with_lexeme(result, type, loc_src, lexeme);
     return result;
 }
 
@@ -30,3 +40,58 @@ void token_destroy(Token *token)
     free(token);
 }
 
+#define TOKEN_KEYWORD(_t)                                        \
+    (memcmp(str + 1, token_strings[(_t)] + 1, len - 1) == 0      \
+     ? (_t) : TT_NA)
+
+// Keep in sync with the keyword entries of token_strings. Every keyword
+// is unique by its length and first character, so one memcmp decides.
+TokenType token_keyword(char *str, size_t len)
+{
+    switch (len) {
+    case 2:
+        if (str[0] == 'i')
+            return TOKEN_KEYWORD(TT_IF);
+        break;
+
+    case 3:
+        switch (str[0]) {
+        case 'i': return TOKEN_KEYWORD(TT_INT);
+        case 'n': return TOKEN_KEYWORD(TT_NEW);
+        }
+        break;
+
+    case 4:
+        switch (str[0]) {
+        case 't': return TOKEN_KEYWORD(TT_TRUE);
+        case 'n': return TOKEN_KEYWORD(TT_NULL);
+        case 'c': return TOKEN_KEYWORD(TT_CHAR);
+        case 'u': return TOKEN_KEYWORD(TT_UINT);
+        case 'b': return TOKEN_KEYWORD(TT_BOOL);
+        case 'e': return TOKEN_KEYWORD(TT_ELSE);
+        }
+        break;
+
+    case 5:
+        switch (str[0]) {
+        case 'f': return TOKEN_KEYWORD(TT_FALSE);
+        case 'w': return TOKEN_KEYWORD(TT_WHILE);
+        }
+        break;
+
+    case 6:
+        switch (str[0]) {
+        case 's': return TOKEN_KEYWORD(TT_STRUCT);
+        case 'r': return TOKEN_KEYWORD(TT_RETURN);
+        }
+        break;
+
+    case 7:
+        if (str[0] == 't')
+            return TOKEN_KEYWORD(TT_TYPEDEF);
+        break;
+    }
+
+    return TT_NA;
+}
+
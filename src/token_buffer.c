@@ -0,0 +1,80 @@
+#include "../include/token_buffer.h"
+
+void token_buffer_create(TokenBuffer *buffer, size_t initial_size)
+{
+    buffer->size = 0;
+    buffer->allocated = initial_size > 0 ? initial_size : 1;
+
+    buffer->types = malloc(buffer->allocated * sizeof *buffer->types);
+    buffer->lexemes = malloc(buffer->allocated * sizeof *buffer->lexemes);
+    buffer->values = malloc(buffer->allocated * sizeof *buffer->values);
+    buffer->locs = malloc(buffer->allocated * sizeof *buffer->locs);
+}
+
+void token_buffer_destroy(TokenBuffer *buffer)
+{
+    free(buffer->types);
+    free(buffer->lexemes);
+    free(buffer->values);
+    free(buffer->locs);
+}
+
+static void token_buffer_resize(TokenBuffer *buffer, size_t new_size)
+{
+    buffer->types = realloc(buffer->types, new_size * sizeof *buffer->types);
+    buffer->lexemes = realloc(buffer->lexemes, 
+                              new_size * sizeof *buffer->lexemes);
+    buffer->values = realloc(buffer->values, 
+                             new_size * sizeof *buffer->values);
+    buffer->locs = realloc(buffer->locs, new_size * sizeof *buffer->locs);
+    buffer->allocated = new_size;
+}
+
+void token_buffer_push(TokenBuffer *buffer, Token *token)
+{
+    if (buffer->size == buffer->allocated)
+        token_buffer_resize(buffer, buffer->allocated * 2);
+
+    size_t i = buffer->size++;
+    buffer->types[i] = token->type;
+    buffer->lexemes[i] = token->lexeme;
+    buffer->values[i] = token->value_as;
+    buffer->locs[i] = token->loc;
+}
+
+void token_buffer_append(TokenBuffer *buffer, TokenBuffer *other)
+{
+    size_t new_size = buffer->allocated;
+    while (new_size < buffer->size + other->size)
+        new_size *= 2;
+
+    if (new_size != buffer->allocated)
+        token_buffer_resize(buffer, new_size);
+
+    size_t i = buffer->size;
+    memcpy(buffer->types + i, other->types, 
+           other->size * sizeof *other->types);
+    memcpy(buffer->lexemes + i, other->lexemes, 
+           other->size * sizeof *other->lexemes);
+    memcpy(buffer->values + i, other->values, 
+           other->size * sizeof *other->values);
+    memcpy(buffer->locs + i, other->locs, 
+           other->size * sizeof *other->locs);
+
+    buffer->size += other->size;
+}
+
+void token_buffer_get(TokenBuffer *buffer, size_t index, Token *dest)
+{
+    if (index >= buffer->size)
+        index = buffer->size - 1;
+
+    dest->type = buffer->types[index];
+    dest->lexeme = buffer->lexemes[index];
+    dest->value_as = buffer->values[index];
+    // Only the null constant carries the "null" lexeme
+    dest->is_null = dest->type == TT_C && 
+        dest->lexeme == TT_NULL;
+
+    dest->loc = buffer->locs[index];
+}
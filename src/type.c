@@ -1,137 +1,403 @@
 #include "../include/type.h"
 #include "../include/token.h"
 
-#define TYPE_TABLE_SIZE 128 // Always power of 2
+typedef struct TypeBlock TypeBlock;
 
-static Type *type_table[TYPE_TABLE_SIZE] = {NULL};
+struct TypeBlock {
+    TypeBlock *next;
+    size_t used;
+    Type types[TYPE_BLOCK_SIZE];
+};
+
+static TypeBlock *type_blocks = NULL;
+static size_t type_count = 0;
+
+// Indexed by name
+static Type **type_names = NULL;
+static size_t type_names_allocated = 0;
+
+// Open addressing on (child, elements), grown past 3/4 full
+static Type **type_arrays = NULL;
+static size_t type_arrays_allocated = 0;
+static size_t type_arrays_count = 0;
 
 Type *type_int;
 Type *type_bool;
 Type *type_char;
 Type *type_uint;
 
-static const size_t type_sizes_x86[5] = { 
-    4, // int 
-    1, // bool
-    1, // char
-    4, // uint
-    4  // pointer
-};
+const Target *type_target = NULL;
+bool type_reorder_fields = false;
+
+static StrId *type_kept_layouts = NULL;
+static size_t type_kept_layouts_count = 0;
 
-static const size_t *type_sizes = NULL;
+// Defined structs, in definition order
+static Type **type_structs = NULL;
+static size_t type_structs_count = 0;
+static size_t type_structs_allocated = 0;
 
-static inline Type *type_table_add(Type *type)
+Type *type_new(StrId name)
 {
-    size_t index = str_hash(type->name) & (TYPE_TABLE_SIZE - 1); 
+    if (type_blocks == NULL || type_blocks->used == TYPE_BLOCK_SIZE) {
+        TypeBlock *block = malloc(sizeof *block);
+        block->next = type_blocks;
+        block->used = 0;
+        type_blocks = block;
+    }
 
-    Type *t = type_get(type->name);
-    if (t == NULL) {
-        type->next = type_table[index];
-        type_table[index] = type;
+    Type *type = &type_blocks->types[type_blocks->used++];
+    memset(type, 0, sizeof *type);
+    type->id = type_count++;
+    type->name = name;
 
-        return type;
+    return type;
+}
+
+void type_name(StrId name, Type *type)
+{
+    if (name >= type_names_allocated) {
+        size_t allocated = type_names_allocated == 0 
+            ? 64 : type_names_allocated;
+        while (allocated <= name)
+            allocated *= 2;
+
+        type_names = realloc(type_names, allocated * sizeof *type_names);
+        memset(type_names + type_names_allocated, 0, 
+               (allocated - type_names_allocated) * sizeof *type_names);
+        type_names_allocated = allocated;
     }
 
-    if (t->is_defined)
-        return NULL;
+    type_names[name] = type;
+    if (type->name == STR_NONE)
+        type->name = name;
+}
 
-    free(t->name);
-    *t = *type;
-    free(type);
-    return t;
-}
-
-#define TYPE_PRIM_INIT(_v, _n, _t)      \
-    do {                                \
-        (_v) = calloc(1, sizeof *(_v)); \
-        (_v)->name = (_n);              \
-        (_v)->op = (_t);                \
-        (_v)->size = type_sizes[(_t)];  \
-        (_v)->align = type_sizes[(_t)]; \
-        (_v)->is_defined = true;        \
-        type_table_add((_v));           \
-    } while(0) 
+static inline size_t type_array_hash(Type *child, size_t elements)
+{
+    return str_hash_word(str_hash_word(STR_HASH_SEED, (uintptr_t) child), 
+                         elements);
+}
 
-void type_init()
+static Type **type_array_slot(Type **table, size_t allocated, 
+                              Type *child, size_t elements)
 {
-    // TODO: Change this for a specific architecture in runtime
-    type_sizes = type_sizes_x86;
+    size_t mask = allocated - 1;
+    size_t index = type_array_hash(child, elements) & mask;
+
+    while (table[index] != NULL && (table[index]->child != child || 
+           table[index]->elements != elements))
+        index = (index + 1) & mask;
 
-    TYPE_PRIM_INIT(type_int, token_strings[TT_INT], TO_INT);
-    TYPE_PRIM_INIT(type_bool, token_strings[TT_BOOL], TO_BOOL);
-    TYPE_PRIM_INIT(type_char, token_strings[TT_CHAR], TO_CHAR);
-    TYPE_PRIM_INIT(type_uint, token_strings[TT_UINT], TO_UINT);
+    return &table[index];
 }
 
-void type_deinit()
+static void type_arrays_grow()
 {
-    for (size_t i = 0; i < TYPE_TABLE_SIZE; i++) {
-        Type *curr = type_table[i];
-        while (curr != NULL) {
-            Type *next = curr->next; 
-            for (size_t j = 0; j < curr->fields_count; j++) 
-                free(curr->fields[j].name);
-            free(curr);
-
-            curr = next;
+    size_t allocated = type_arrays_allocated == 0 
+        ? TYPE_ARRAYS_INITIAL_SIZE : type_arrays_allocated * 2;
+    Type **table = calloc(allocated, sizeof *table);
+
+    for (size_t i = 0; i < type_arrays_allocated; i++) {
+        Type *array = type_arrays[i];
+        if (array != NULL) {
+            *type_array_slot(table, allocated, 
+                             array->child, array->elements) = array;
         }
     }
+
+    free(type_arrays);
+    type_arrays = table;
+    type_arrays_allocated = allocated;
 }
 
-Type *type_add(char *name)
+#define TYPE_PRIM_INIT(_v, _n, _t)               \
+    do {                                         \
+        (_v) = type_new((_n));                   \
+        (_v)->op = (_t);                         \
+        (_v)->size = type_target->sizes[(_t)];   \
+        (_v)->align = type_target->aligns[(_t)]; \
+        (_v)->is_defined = true;                 \
+        type_name((_n), (_v));                   \
+    } while(0) 
+
+void type_init(const Target *target)
 {
-    Type *type = calloc(1, sizeof *type);
-    type->name = name;
+    type_target = target;
 
-    return type_table_add(type);
+    TYPE_PRIM_INIT(type_int, TT_INT, TO_INT);
+    TYPE_PRIM_INIT(type_bool, TT_BOOL, TO_BOOL);
+    TYPE_PRIM_INIT(type_char, TT_CHAR, TO_CHAR);
+    TYPE_PRIM_INIT(type_uint, TT_UINT, TO_UINT);
 }
 
-Type *type_get(char *name)
+void type_deinit()
 {
-    size_t index = str_hash(name) & (TYPE_TABLE_SIZE - 1); 
-    for (Type *curr = type_table[index]; curr != NULL; curr = curr->next) {
-        if (curr->name == name)
-            return curr;
+    while (type_blocks != NULL) {
+        TypeBlock *next = type_blocks->next;
+
+        // Names are interned, so only the fields arrays are owned
+        for (size_t i = 0; i < type_blocks->used; i++)
+            free(type_blocks->types[i].fields);
+        free(type_blocks);
+
+        type_blocks = next;
     }
+    type_count = 0;
 
-    return NULL;
+    free(type_names);
+    type_names = NULL;
+    type_names_allocated = 0;
+
+    free(type_arrays);
+    type_arrays = NULL;
+    type_arrays_allocated = 0;
+    type_arrays_count = 0;
+
+    free(type_structs);
+    type_structs = NULL;
+    type_structs_count = 0;
+    type_structs_allocated = 0;
+
+    free(type_kept_layouts);
+    type_kept_layouts = NULL;
+    type_kept_layouts_count = 0;
 }
 
-Type *type_pointer(char *name, Type *child)
+Type *type_add(StrId name)
+{
+    Type *type = type_new(name);
+    type_name(name, type);
+
+    return type;
+}
+
+Type *type_get(StrId name)
+{
+    return name < type_names_allocated ? type_names[name] : NULL;
+}
+
+static void type_pointer_init(Type *type, Type *child)
 {
-    Type *type = calloc(1, sizeof *type);
-    type->name = name;
     type->child = child;
     type->op = TO_POINTER;
-    type->size = type_sizes[TO_POINTER];
-    type->align = type_sizes[TO_POINTER];
+    type->size = type_target->sizes[TO_POINTER];
+    type->align = type_target->aligns[TO_POINTER];
     type->is_defined = true;
-
-    return type_table_add(type);
 }
 
-Type *type_array(char *name, Type *child, size_t elements)
+static void type_array_init(Type *type, Type *child, size_t elements)
 {
-    Type *type = calloc(1, sizeof *type);
-    type->name = name;
     type->child = child;
     type->op = TO_ARRAY;
+    type->elements = elements;
     type->size = child->size * elements;
     type->align = child->align;
     type->is_defined = true;
+}
 
-    return type_table_add(type);
+// Pointer or array types are only looked up through these two
+static Type **type_pointer_slot(Type *child)
+{
+    return &child->pointer;
 }
 
-Type *type_struct(char *name, Field *fields, size_t fields_count)
+static Type **type_array_find(Type *child, size_t elements)
 {
-    Type *type = calloc(1, sizeof *type);
-    type->name = name;
-    type->op = TO_STRUCT;
-    type->is_defined = true;
-    type->fields = fields;
-    type->fields_count = fields_count;
+    if ((type_arrays_count + 1) * 4 > type_arrays_allocated * 3)
+        type_arrays_grow();
+
+    return type_array_slot(type_arrays, type_arrays_allocated, 
+                           child, elements);
+}
+
+Type *type_pointer_to(Type *child)
+{
+    child = type_canonical(child);
+
+    Type **slot = type_pointer_slot(child);
+    if (*slot == NULL) {
+        *slot = type_new(STR_NONE);
+        type_pointer_init(*slot, child);
+    }
+
+    return *slot;
+}
+
+Type *type_array_of(Type *child, size_t elements)
+{
+    child = type_canonical(child);
+
+    Type **slot = type_array_find(child, elements);
+    if (*slot == NULL) {
+        *slot = type_new(STR_NONE);
+        type_array_init(*slot, child, elements);
+        type_arrays_count++;
+    }
+
+    return *slot;
+}
+
+// Rehashes the arrays by their current child, dropping those that became
+// aliases
+static void type_arrays_rebuild()
+{
+    Type **table = calloc(type_arrays_allocated, sizeof *table);
+    type_arrays_count = 0;
+
+    for (size_t i = 0; i < type_arrays_allocated; i++) {
+        Type *array = type_arrays[i];
+        if (array != NULL && array->canonical == NULL) {
+            *type_array_slot(table, type_arrays_allocated, 
+                             array->child, array->elements) = array;
+            type_arrays_count++;
+        }
+    }
+
+    free(type_arrays);
+    type_arrays = table;
+}
+
+// Makes type an alias of canonical. The pointer and array types built on
+// type move over to canonical, or become aliases of the equal ones it
+// already has, so each structure stays a single Type.
+static void type_merge(Type *type, Type *canonical)
+{
+    Type *pointer = type->pointer;
+    size_t id = type->id;
+
+    *type = *canonical;
+    type->id = id;
+    type->name = canonical->name;
+    type->pointer = NULL;
+    type->canonical = canonical;
+
+    // Defined as a pointer to itself, like "typedef T* T"
+    if (pointer == canonical)
+        type->child = canonical->child = canonical;
+    else if (pointer != NULL && canonical->pointer == NULL) {
+        pointer->child = canonical;
+        canonical->pointer = pointer;
+    }
+    else if (pointer != NULL)
+        type_merge(pointer, canonical->pointer);
+
+    // Arrays are few, and defining a type that is already used as an
+    // array's child is rare, so they are simply searched for
+    size_t count = 0;
+    for (size_t i = 0; i < type_arrays_allocated; i++) {
+        Type *array = type_arrays[i];
+        if (array != NULL && array->child == type && 
+            array->canonical == NULL)
+            count++;
+    }
+
+    if (count == 0)
+        return;
+
+    Type **arrays = malloc(count * sizeof *arrays);
+    count = 0;
+    for (size_t i = 0; i < type_arrays_allocated; i++) {
+        Type *array = type_arrays[i];
+        if (array != NULL && array->child == type && 
+            array->canonical == NULL)
+            arrays[count++] = array;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Type *array = arrays[i];
+        Type *equal = *type_array_slot(type_arrays, type_arrays_allocated,
+                                       canonical, array->elements);
+
+        if (equal != NULL && equal != array)
+            type_merge(array, equal);
+        else
+            array->child = canonical;
+    }
+
+    free(arrays);
+    type_arrays_rebuild();
+}
+
+// Defines a forward declared type in place, so the types already pointing
+// to it see the definition. If an equal type exists it stays the one 
+// handed out from now on.
+static Type *type_define(Type *type, Type **slot)
+{
+    if (*slot == NULL) {
+        *slot = type;
+        return type;
+    }
+
+    Type *canonical = *slot;
+    type_merge(type, canonical);
+
+    return canonical;
+}
+
+Type *type_pointer(StrId name, Type *child)
+{
+    child = type_canonical(child);
+
+    Type *type = type_get(name);
+    if (type == NULL) {
+        type = type_pointer_to(child);
+        type_name(name, type);
+        return type;
+    }
+
+    if (type->is_defined)
+        return NULL;
 
+    Type **slot = type_pointer_slot(child);
+    if (*slot == NULL)
+        type_pointer_init(type, child);
+
+    type = type_define(type, slot);
+    type_name(name, type);
+    return type;
+}
+
+Type *type_array(StrId name, Type *child, size_t elements)
+{
+    child = type_canonical(child);
+
+    Type *type = type_get(name);
+    if (type == NULL) {
+        type = type_array_of(child, elements);
+        type_name(name, type);
+        return type;
+    }
+
+    if (type->is_defined)
+        return NULL;
+
+    Type **slot = type_array_find(child, elements);
+    if (*slot == NULL) {
+        type_array_init(type, child, elements);
+        type_arrays_count++;
+    }
+
+    type = type_define(type, slot);
+    type_name(name, type);
+    return type;
+}
+
+static void type_add_struct(Type *type)
+{
+    if (type_structs_count == type_structs_allocated) {
+        type_structs_allocated = type_structs_allocated == 0 
+            ? 16 : type_structs_allocated * 2;
+        type_structs = realloc(type_structs, 
+                               type_structs_allocated * sizeof *type_structs);
+    }
+
+    type_structs[type_structs_count++] = type;
+}
+
+// Assigns offsets in the current field order, returns the size
+static size_t type_layout(Field *fields, size_t fields_count, size_t *align)
+{
     size_t max_field_align = 1;
 
     size_t offset = 0;
@@ -152,8 +418,184 @@ Type *type_struct(char *name, Field *fields, size_t fields_count)
     if (mod != 0) 
         offset += max_field_align - mod;
 
-    type->size = offset;
-    type->align = max_field_align;
+    *align = max_field_align;
+    return offset;
+}
+
+bool type_is_layout_kept(StrId name)
+{
+    for (size_t i = 0; i < type_kept_layouts_count; i++) {
+        if (type_kept_layouts[i] == name)
+            return true;
+    }
+
+    return false;
+}
+
+// Stable, so fields of equal alignment stay in declaration order
+static void type_sort_fields(Field *fields, size_t fields_count)
+{
+    for (size_t i = 1; i < fields_count; i++) {
+        Field field = fields[i];
+
+        size_t j = i;
+        for (; j > 0 && fields[j - 1].type->align < field.type->align; j--)
+            fields[j] = fields[j - 1];
+
+        fields[j] = field;
+    }
+}
+
+Type *type_struct(StrId name, Field *fields, size_t fields_count)
+{
+    Type *type = type_get(name);
+    if (type != NULL && type->is_defined)
+        return NULL;
+
+    // Structs are nominal, a forward declared one is simply filled in
+    if (type == NULL) {
+        type = type_new(name);
+        type_name(name, type);
+    }
+
+    type->op = TO_STRUCT;
+    type->is_defined = true;
+    type->fields = fields;
+    type->fields_count = fields_count;
+
+    type->size = type_layout(fields, fields_count, &type->align);
+    type->declared_size = type->size;
+
+    if (type_reorder_fields && !type_is_layout_kept(name)) {
+        type_sort_fields(fields, fields_count);
+        type->size = type_layout(fields, fields_count, &type->align);
+    }
+
+    type_add_struct(type);
+    return type;
+}
+
+void type_enter(Type *type)
+{
+    if (!type->is_defined || type->canonical != NULL)
+        return;
+
+    switch (type->op) {
+    case TO_POINTER:
+        *type_pointer_slot(type->child) = type;
+        break;
+
+    case TO_ARRAY:
+        *type_array_find(type->child, type->elements) = type;
+        type_arrays_count++;
+        break;
+
+    case TO_STRUCT:
+        type_add_struct(type);
+        break;
+
+    default:
+        break;
+    }
+}
+
+Type **type_list(size_t *count)
+{
+    *count = type_count;
+    Type **result = malloc(type_count * sizeof *result);
+
+    for (TypeBlock *block = type_blocks; block != NULL; block = block->next) {
+        for (size_t i = 0; i < block->used; i++)
+            result[block->types[i].id] = &block->types[i];
+    }
+
+    return result;
+}
+
+StrId type_names_end()
+{
+    return type_names_allocated;
+}
+
+void type_keep_layout(StrId name)
+{
+    type_kept_layouts = realloc(type_kept_layouts, 
+                                (type_kept_layouts_count + 1) 
+                                * sizeof *type_kept_layouts);
+    type_kept_layouts[type_kept_layouts_count++] = name;
+}
+
+StrId *type_layouts_kept(size_t *count)
+{
+    *count = type_kept_layouts_count;
+    return type_kept_layouts;
+}
 
-    return type_table_add(type);
+size_t type_split_offset(Type *array, Field *field)
+{
+    Type *type = type_canonical(array->child);
+
+    size_t offset = 0;
+    for (Field *curr = type->fields; ; curr++) {
+        size_t mod = offset % curr->type->align;
+        if (mod != 0)
+            offset += curr->type->align - mod;
+
+        if (curr == field)
+            return offset;
+
+        offset += curr->type->size * array->elements;
+    }
+}
+
+size_t type_split_size(Type *array)
+{
+    Type *type = type_canonical(array->child);
+    if (type->fields_count == 0)
+        return 0;
+
+    Field *last = &type->fields[type->fields_count - 1];
+    return type_split_offset(array, last) 
+        + last->type->size * array->elements;
+}
+
+void type_layout_report(FILE *out)
+{
+    for (size_t i = 0; i < type_structs_count; i++) {
+        Type *type = type_structs[i];
+
+        size_t padding = type->size;
+        size_t crossings = 0;
+        for (size_t j = 0; j < type->fields_count; j++) {
+            Field *field = &type->fields[j];
+            padding -= field->type->size;
+
+            // With the struct starting on a line
+            if (field->type->size != 0 &&
+                field->offset / TYPE_CACHE_LINE_SIZE != 
+                (field->offset + field->type->size - 1) 
+                / TYPE_CACHE_LINE_SIZE)
+                crossings++;
+        }
+
+        fprintf(out, "struct %s: size %zu, align %zu, padding %zu, "
+                "cache line crossings %zu", 
+                str_chars(type->name), type->size, type->align, 
+                padding, crossings);
+
+        if (type->size != type->declared_size)
+            fprintf(out, ", %zu in declaration order", type->declared_size);
+
+        fprintf(out, "\n");
+    }
+}
+
+Field *type_field(Type *type, StrId name)
+{
+    for (size_t i = 0; i < type->fields_count; i++) {
+        if (type->fields[i].name == name)
+            return &type->fields[i];
+    }
+
+    return NULL;
 }
@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/parser.h"
+#include "../include/lower.h"
+#include "../include/symbol_table.h"
+
+// Adds a parsed function to an AstBuffer, rebuilds its statements from the
+// buffer and checks that they match the parsed ones node for node, that
+// every symbol is stored once, that the split analysis reads the right
+// arrays from the buffer and that the lowered function is not added.
+
+static char *source =
+    "typedef int* intp;\n"
+    "typedef struct { char tag; intp p; int v } pair;\n"
+    "typedef pair[100] pairs;\n"
+    "typedef pairs[4] grid;\n"
+    "typedef pair* pairp;\n"
+    "int f(int i, bool b) {\n"
+    "    pairs ps; pairs qs; pairs rs; pair t; int y; grid g; char c;\n"
+    "    pairp q;\n"
+    "    y = ps[i].v + ps[i + 1].v * -3;\n"
+    "    ps[2].tag = c;\n"
+    "    ps[ps[i].v].p = ps[0].p;\n"
+    "    qs[i] = t;\n"
+    "    y = qs[i].v;\n"
+    "    rs[i].v = 3;\n"
+    "    y = rs[i]&@.v;\n"
+    "    y = g[1][i].v;\n"
+    "    if y > 4000000000 && b { y = 1 } else { c = ps[y].tag };\n"
+    "    if !b { ps[1].p = null };\n"
+    "    while (y + 1) > 3 || b && true { y = y - 1; b = false };\n"
+    "    y = f(y, !b);\n"
+    "    q = new pair*;\n"
+    "    return ps[i].tag\n"
+    "}\n";
+
+static char *write_input(char *text)
+{
+    char *path = strdup("/tmp/c0_ast_buffer_test_XXXXXX");
+    int fd = mkstemp(path);
+    if (fd == -1 || write(fd, text, strlen(text)) != (ssize_t) strlen(text)) {
+        perror(path);
+        exit(1);
+    }
+
+    close(fd);
+    return path;
+}
+
+static bool expr_equal(Expr *a, Expr *b);
+
+static bool exprs_equal(Expr **a, Expr **b)
+{
+    if (a == NULL || b == NULL)
+        return a == b;
+
+    size_t i = 0;
+    for (; a[i] != NULL && b[i] != NULL; i++) {
+        if (!expr_equal(a[i], b[i]))
+            return false;
+    }
+
+    return a[i] == b[i];
+}
+
+static bool expr_equal(Expr *a, Expr *b)
+{
+    if (a->type != b->type || a->loc.start != b->loc.start ||
+        a->loc.end != b->loc.end)
+        return false;
+
+    switch (a->type) {
+    case ET_BINARY:
+        return a->as.binary.op == b->as.binary.op &&
+            expr_equal(a->as.binary.left, b->as.binary.left) &&
+            expr_equal(a->as.binary.right, b->as.binary.right);
+
+    case ET_UNARY:
+        return a->as.unary.op == b->as.unary.op &&
+            expr_equal(a->as.unary.e, b->as.unary.e);
+
+    case ET_ACCESS:
+        return a->as.access.na == b->as.access.na &&
+            expr_equal(a->as.access.left, b->as.access.left);
+
+    case ET_ARR_ACCESS:
+        return expr_equal(a->as.arr_access.left, b->as.arr_access.left) &&
+            expr_equal(a->as.arr_access.index, b->as.arr_access.index);
+
+    case ET_C:
+        return a->as.c == b->as.c;
+
+    case ET_BC:
+        return a->as.bc == b->as.bc;
+
+    case ET_CC:
+        return a->as.cc == b->as.cc;
+
+    case ET_NA:
+        return a->as.na.name == b->as.na.name &&
+            a->as.na.sym == b->as.na.sym;
+
+    case ET_NULL:
+        return true;
+
+    case ET_PATH:
+        return false;
+    }
+
+    return false;
+}
+
+static bool stmts_equal(Stmt **a, Stmt **b);
+
+static bool stmt_equal(Stmt *a, Stmt *b)
+{
+    if (a->type != b->type || a->loc.start != b->loc.start ||
+        a->loc.end != b->loc.end)
+        return false;
+
+    switch (a->type) {
+    case ST_ASSIGN:
+        return expr_equal(a->as.assign.left, b->as.assign.left) &&
+            expr_equal(a->as.assign.right, b->as.assign.right);
+
+    case ST_IF:
+        return expr_equal(a->as.if_stmt.cond, b->as.if_stmt.cond) &&
+            stmts_equal(a->as.if_stmt.then_block, b->as.if_stmt.then_block) &&
+            stmts_equal(a->as.if_stmt.else_block, b->as.if_stmt.else_block);
+
+    case ST_WHILE:
+        return expr_equal(a->as.while_stmt.cond, b->as.while_stmt.cond) &&
+            stmts_equal(a->as.while_stmt.block, b->as.while_stmt.block);
+
+    case ST_FUNCALL:
+        return a->as.funcall.na == b->as.funcall.na &&
+            a->as.funcall.sym == b->as.funcall.sym &&
+            expr_equal(a->as.funcall.left, b->as.funcall.left) &&
+            exprs_equal(a->as.funcall.args, b->as.funcall.args);
+
+    case ST_NEW:
+        return a->as.new_stmt.na == b->as.new_stmt.na &&
+            expr_equal(a->as.new_stmt.left, b->as.new_stmt.left);
+
+    case ST_RETURN:
+        return expr_equal(a->as.return_stmt, b->as.return_stmt);
+    }
+
+    return false;
+}
+
+static bool stmts_equal(Stmt **a, Stmt **b)
+{
+    if (a == NULL || b == NULL)
+        return a == b;
+
+    size_t i = 0;
+    for (; a[i] != NULL && b[i] != NULL; i++) {
+        if (!stmt_equal(a[i], b[i]))
+            return false;
+    }
+
+    return a[i] == b[i];
+}
+
+static bool check_round_trip(Function *f, AstBuffer *tree, AstNode body)
+{
+    bool result = true;
+
+    Stmt **stmts = ast_buffer_stmts(tree, body);
+    size_t count = 0;
+    while (stmts[count] != NULL)
+        count++;
+
+    // The return statement is the last of the list
+    Stmt *return_stmt = stmts[count - 1];
+    stmts[count - 1] = NULL;
+
+    if (!stmts_equal(f->stmts, stmts)) {
+        printf("statements differ after the round trip\n");
+        result = false;
+    }
+
+    if (!stmt_equal(f->return_stmt, return_stmt)) {
+        printf("return statement differs after the round trip\n");
+        result = false;
+    }
+
+    // Each node refers to its children by lower indices
+    for (size_t i = 0; i < tree->size; i++) {
+        unsigned char kind = tree->kinds[i];
+        bool has_lhs = kind == ET_BINARY || kind == ET_UNARY ||
+            kind == ET_ACCESS || kind == ET_ARR_ACCESS ||
+            (kind >= AK_STMT && kind < AK_LIST);
+        bool has_rhs = kind == ET_BINARY || kind == ET_ARR_ACCESS ||
+            kind == AK_STMT + ST_ASSIGN || kind == AK_STMT + ST_IF ||
+            kind == AK_STMT + ST_WHILE || kind == AK_STMT + ST_FUNCALL;
+
+        if ((has_lhs && tree->lhs[i] >= i) ||
+            (has_rhs && tree->rhs[i] >= i)) {
+            printf("node %zu has a child at or after it\n", i);
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+static bool check_syms(AstBuffer *tree)
+{
+    bool result = true;
+
+    for (size_t i = 0; i < tree->syms_size; i++) {
+        for (size_t j = i + 1; j < tree->syms_size; j++) {
+            if (tree->syms[i] == tree->syms[j]) {
+                printf("symbol %s is stored more than once\n",
+                       str_chars(tree->syms[i]->name));
+                result = false;
+            }
+        }
+    }
+
+    // i, b, ps, qs, rs, t, y, g, c, q and f
+    if (tree->syms_size != 11) {
+        printf("%zu symbols stored, expected 11\n", tree->syms_size);
+        result = false;
+    }
+
+    return result;
+}
+
+static bool check_split(Function *f, char *name, bool expected)
+{
+    StrId id = str_intern_null_term(name);
+
+    for (size_t i = 0; i < f->locals_count; i++) {
+        if (f->locals[i]->name != id)
+            continue;
+
+        if (f->locals[i]->is_split != expected) {
+            printf("%s is %s, expected it %s\n", name,
+                   f->locals[i]->is_split ? "split" : "not split",
+                   expected ? "split" : "not split");
+            return false;
+        }
+
+        return true;
+    }
+
+    printf("no local named %s\n", name);
+    return false;
+}
+
+int main()
+{
+    bool result = true;
+
+    log_init(true);
+    source_init();
+    str_init(token_strings, TT_KEYWORD_COUNT);
+    type_init(target_default);
+    symtable_init();
+    ast_init();
+
+    char *path = write_input(source);
+    if (!lexer_init(path))
+        return 1;
+
+    parser_init(NULL, NULL);
+    Function *f = parser_prog();
+    if (f == NULL || parser->error) {
+        printf("the input did not parse\n");
+        return 1;
+    }
+
+    AstBuffer tree;
+    ast_buffer_create(&tree, 16);
+    AstNode body = ast_buffer_add_function(&tree, f);
+
+    result &= check_round_trip(f, &tree, body);
+    result &= check_syms(&tree);
+
+    if (!lower_function(f, &tree)) {
+        printf("the input did not lower\n");
+        result = false;
+    }
+
+    // Elements of ps are only used to reach a field, qs is assigned whole
+    // and rs has its elements' address taken
+    result &= check_split(f, "ps", true);
+    result &= check_split(f, "qs", false);
+    result &= check_split(f, "rs", false);
+
+    size_t size = tree.size;
+    size_t lists_size = tree.lists_size;
+    size_t syms_size = tree.syms_size;
+    if (ast_buffer_add_function(&tree, f) != AST_NONE ||
+        tree.size != size || tree.lists_size != lists_size ||
+        tree.syms_size != syms_size) {
+        printf("the lowered function was added\n");
+        result = false;
+    }
+
+    ast_buffer_destroy(&tree);
+    function_free(f);
+    parser_deinit();
+    lexer_deinit();
+    unlink(path);
+    free(path);
+    ast_deinit();
+    symtable_deinit();
+    type_deinit();
+    str_deinit();
+    source_deinit();
+
+    printf("%s\n", result ? "ok" : "failed");
+    return result ? 0 : 1;
+}
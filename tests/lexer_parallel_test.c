@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../include/lexer.h"
+#include "../include/io/log.h"
+#include "../include/io/source.h"
+
+// Lexes inputs sequentially and in parallel and checks that both give the
+// same tokens at the same offsets. Runs over the given sample sources, each
+// repeated until it can be split, and over synthetic inputs that put a
+// token or a line break at every offset around each chunk boundary. Also
+// checks that lexing a pipe ahead of parsing keeps all of its lines, and
+// that the lexer thread hands over each line as soon as it arrives.
+//
+//   lexer_parallel_test [sample.c0...]
+
+static const size_t sample_jobs[] = { 2, 3, 4 };
+// Every boundary of one input tests another construct and shift
+#define CONSTRUCT_JOBS 16
+
+// Put across a chunk boundary, the newline ends the line in every case
+static char *constructs[] = {
+    "\n",
+    "\r\n",
+    "\r\r\n",
+    " \t \r\n",
+    "a_long_identifier_0123456789\n",
+    "if\r\n",
+    "while\n",
+    "1234567890\r\n",
+    "42u\n",
+    ">=\n",
+    "||\r\n",
+    "&&\n",
+    "$\n",
+};
+
+static char *filler = "x = y + 12 * (z - 3u); if a >= b || c { q = r@ };\n";
+
+static char *write_input(char *text, size_t size)
+{
+    char *path = strdup("/tmp/c0_lexer_test_XXXXXX");
+    int fd = mkstemp(path);
+    if (fd == -1 || write(fd, text, size) != (ssize_t) size) {
+        perror(path);
+        exit(1);
+    }
+
+    close(fd);
+    return path;
+}
+
+// jobs 0 lexes sequentially
+static void lex(char *path, size_t jobs, TokenBuffer *buffer, uint32_t *base,
+                bool *error)
+{
+    if (!lexer_init(path))
+        exit(1);
+
+    lexer->is_quiet = true;
+    token_buffer_create(buffer, lexer->source_size / 4);
+
+    if (jobs == 0)
+        lexer_tokenize(buffer);
+    else
+        lexer_tokenize_parallel(buffer, jobs);
+
+    *base = lexer->file->base;
+    *error = lexer->error;
+    lexer_deinit();
+}
+
+// Lexes path sequentially once, then on each of jobs threads
+static bool check(char *name, char *path, const size_t *jobs, size_t count)
+{
+    TokenBuffer expected;
+    uint32_t expected_base;
+    bool expected_error;
+    bool result = true;
+
+    lex(path, 0, &expected, &expected_base, &expected_error);
+
+    for (size_t j = 0; j < count; j++) {
+        TokenBuffer actual;
+        uint32_t actual_base;
+        bool actual_error;
+        bool is_same = true;
+
+        lex(path, jobs[j], &actual, &actual_base, &actual_error);
+
+        if (expected.size != actual.size) {
+            printf("%s, %zu jobs: %zu tokens, expected %zu\n",
+                   name, jobs[j], actual.size, expected.size);
+            is_same = false;
+        }
+
+        for (size_t i = 0; i < expected.size && i < actual.size && is_same; 
+             i++) {
+            if (expected.types[i] != actual.types[i] ||
+                expected.lexemes[i] != actual.lexemes[i] ||
+                memcmp(&expected.values[i], &actual.values[i],
+                       sizeof(TokenValue)) ||
+                expected.locs[i].start - expected_base !=
+                    actual.locs[i].start - actual_base ||
+                expected.locs[i].end - expected_base !=
+                    actual.locs[i].end - actual_base) {
+                printf("%s, %zu jobs: token %zu differs\n", 
+                       name, jobs[j], i);
+                is_same = false;
+            }
+        }
+
+        if (expected_error != actual_error) {
+            printf("%s, %zu jobs: errors differ\n", name, jobs[j]);
+            is_same = false;
+        }
+
+        token_buffer_destroy(&actual);
+        result &= is_same;
+    }
+
+    token_buffer_destroy(&expected);
+    return result;
+}
+
+static bool check_text(char *name, char *text, size_t size, 
+                       const size_t *jobs, size_t count)
+{
+    char *path = write_input(text, size);
+    bool result = check(name, path, jobs, count);
+
+    unlink(path);
+    free(path);
+    return result;
+}
+
+static char *filled(size_t size)
+{
+    char *result = malloc(size);
+    size_t length = strlen(filler);
+
+    for (size_t i = 0; i < size; i++)
+        result[i] = filler[i % length];
+
+    return result;
+}
+
+// Places the next constructs so that the split point of each chunk falls
+// on the shift-th character of one, following the lexer's boundaries.
+// Advances index and shift past the ones placed.
+static bool check_constructs(size_t *index, size_t *shift)
+{
+    size_t jobs = CONSTRUCT_JOBS;
+    size_t size = jobs * LEXER_MIN_CHUNK_SIZE + 1000;
+    size_t count = sizeof constructs / sizeof *constructs;
+    char *text = filled(size);
+
+    char name[64];
+    snprintf(name, sizeof name, "construct %zu at %zu", *index, *shift);
+
+    size_t begin = 0;
+    for (size_t i = 0; i < jobs - 1 && *index < count; i++) {
+        char *construct = constructs[*index];
+        size_t split = begin + size / jobs;
+        memcpy(text + split - *shift, construct, strlen(construct));
+
+        // Just past the first newline at or after the split point
+        begin = split;
+        while (begin < size && text[begin] != '\r' && text[begin] != '\n')
+            begin++;
+        begin++;
+
+        if (++*shift == strlen(construct)) {
+            (*index)++;
+            *shift = 0;
+        }
+    }
+
+    bool result = check_text(name, text, size, &jobs, 1);
+    free(text);
+    return result;
+}
+
+static bool check_sample(char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    char *sample = NULL;
+    size_t sample_size = 0;
+    size_t allocated = 0;
+    int c;
+    while ((c = fgetc(file)) != EOF) {
+        if (sample_size == allocated) {
+            allocated = allocated ? allocated * 2 : 4096;
+            sample = realloc(sample, allocated);
+        }
+        sample[sample_size++] = c;
+    }
+    fclose(file);
+
+    if (sample_size == 0) {
+        free(sample);
+        return true;
+    }
+
+    // Enough copies for the most jobs to get whole chunks
+    size_t count = sizeof sample_jobs / sizeof *sample_jobs;
+    size_t size = 0;
+    size_t needed = sample_jobs[count - 1] * LEXER_MIN_CHUNK_SIZE;
+    char *text = malloc(needed + sample_size);
+    while (size < needed) {
+        memcpy(text + size, sample, sample_size);
+        size += sample_size;
+    }
+
+    bool result = check_text(path, text, size, sample_jobs, count);
+    free(text);
+    free(sample);
+    return result;
+}
+
+typedef struct PipeInput {
+    int fd;
+    char *text;
+    size_t size;
+} PipeInput;
+
+static void *write_pipe(void *arg)
+{
+    PipeInput *input = arg;
+
+    for (size_t done = 0; done < input->size;) {
+        ssize_t written = write(input->fd, input->text + done, 
+                                input->size - done);
+        if (written <= 0)
+            break;
+
+        done += written;
+    }
+
+    close(input->fd);
+    return NULL;
+}
+
+// Streamed input lexed whole before parsing must still have its first
+// lines for the parser's diagnostics, however many windows came after
+static bool check_stream_history(size_t jobs)
+{
+    char *line = "    x = a $ 3;\n";
+    size_t size = 16 * LEXER_STREAM_WINDOW;
+    char *text = filled(size);
+    memcpy(text + strlen(filler) * 3, line, strlen(line));
+
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("pipe");
+        exit(1);
+    }
+
+    PipeInput input = { fds[1], text, size };
+    pthread_t writer;
+    pthread_create(&writer, NULL, write_pipe, &input);
+
+    if (!lexer_init_fd(fds[0], "pipe"))
+        exit(1);
+
+    lexer->is_quiet = true;
+    TokenBuffer buffer;
+    token_buffer_create(&buffer, size / 4);
+    lexer_tokenize_parallel(&buffer, jobs);
+    pthread_join(writer, NULL);
+
+    bool result = true;
+    char *kept = source_line(lexer->file, 4);
+    if (kept == NULL || strcmp(kept, line)) {
+        printf("pipe, %zu jobs: line 4 is %s\n", jobs, 
+               kept == NULL ? "gone" : "changed");
+        result = false;
+    }
+
+    free(kept);
+    token_buffer_destroy(&buffer);
+    lexer_deinit();
+    free(text);
+    return result;
+}
+
+// The writer sends one line and holds the pipe open, so the lexer thread
+// blocks reading the next. Fails by timing out.
+static bool check_pipeline_line()
+{
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("pipe");
+        exit(1);
+    }
+
+    char *line = "a b c\n";
+    if (write(fds[1], line, strlen(line)) != (ssize_t) strlen(line) ||
+        !lexer_init_fd(fds[0], "pipe"))
+        exit(1);
+
+    LexerPipeline pipeline;
+    if (!lexer_pipeline_start(&pipeline))
+        exit(1);
+
+    bool result = true;
+    alarm(10);
+    for (size_t i = 0; i < 3; i++) {
+        Token token;
+        lexer_pipeline_next(&pipeline, &token);
+        if (token.type != TT_NA) {
+            printf("pipeline: token %zu of the first line is missing\n", i);
+            result = false;
+        }
+    }
+    alarm(0);
+
+    close(fds[1]);
+    lexer_pipeline_stop(&pipeline);
+    lexer_deinit();
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    bool result = true;
+
+    log_init(true);
+    source_init();
+    str_init(token_strings, TT_KEYWORD_COUNT);
+
+    for (int i = 1; i < argc; i++)
+        result &= check_sample(argv[i]);
+
+    size_t index = 0, shift = 0;
+    while (index < sizeof constructs / sizeof *constructs)
+        result &= check_constructs(&index, &shift);
+
+    // No line breaks at all, or only at the very end
+    size_t jobs = 2;
+    size_t size = jobs * LEXER_MIN_CHUNK_SIZE + 1000;
+    char *text = malloc(size);
+    memset(text, 'x', size);
+    for (size_t i = 0; i < size; i += 8)
+        text[i] = ' ';
+    result &= check_text("one line", text, size, &jobs, 1);
+    text[size - 1] = '\n';
+    result &= check_text("one line and newline", text, size, &jobs, 1);
+    free(text);
+
+    result &= check_stream_history(1);
+    result &= check_stream_history(4);
+    result &= check_pipeline_line();
+
+    str_deinit();
+    source_deinit();
+
+    printf("%s\n", result ? "ok" : "failed");
+    return result ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "../include/parser.h"
+#include "../include/symbol_table.h"
+
+// Parses boolean expressions nested 1k to 100k parentheses deep and checks
+// that parse time grows about linearly with the depth. Expressions are
+// parsed recursively, so this runs on a thread with a large stack.
+
+#define NESTING_STACK_SIZE ((size_t) 2 << 30)
+#define NESTING_RUNS 3
+// Allowed growth of the time per level from the shallowest input timed
+// reliably to the deepest, quadratic parsing gives about the depth ratio
+#define NESTING_MAX_SLOWDOWN 3.0
+#define NESTING_MIN_SECONDS 0.005
+
+static const size_t depths[] = { 1000, 2000, 5000, 10000, 20000, 50000, 
+                                 100000 };
+#define DEPTHS_COUNT (sizeof depths / sizeof *depths)
+
+// Appends depth levels of "(...) && b" and "(...) || !b" around "a > c"
+static void write_expression(FILE *file, size_t depth)
+{
+    for (size_t i = 0; i < depth; i++)
+        fputc('(', file);
+
+    fputs("a > c", file);
+
+    for (size_t i = 0; i < depth; i++)
+        fputs(i % 2 == 0 ? ") && b" : ") || !b", file);
+}
+
+static char *write_input(size_t depth)
+{
+    char *path = strdup("/tmp/c0_nesting_test_XXXXXX");
+    int fd = mkstemp(path);
+    FILE *file = fd == -1 ? NULL : fdopen(fd, "w");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+
+    fputs("int foo(int a, bool b, int c)\n{\n    bool y;\n    y = ", file);
+    write_expression(file, depth);
+    fputs(";\n    if ", file);
+    write_expression(file, depth);
+    fputs(" { y = b };\n    return y\n}\n", file);
+
+    fclose(file);
+    return path;
+}
+
+static double now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Seconds to parse path, pre-tokenized so only the parser is timed.
+// Negative if it did not parse.
+static double parse(char *path)
+{
+    str_init(token_strings, TT_KEYWORD_COUNT);
+    type_init(target_default);
+    symtable_init();
+
+    if (!lexer_init(path))
+        exit(1);
+
+    TokenBuffer tokens;
+    token_buffer_create(&tokens, lexer->source_size / 4);
+    lexer_tokenize(&tokens);
+    parser_init(&tokens, NULL);
+
+    double start = now();
+    Function *f = parser_prog();
+    double seconds = now() - start;
+
+    if (f == NULL || parser->error)
+        seconds = -1;
+    if (f != NULL)
+        function_free(f);
+
+    parser_deinit();
+    token_buffer_destroy(&tokens);
+    lexer_deinit();
+    // Each input is a translation unit of its own
+    ast_reset();
+    symtable_deinit();
+    type_deinit();
+    str_deinit();
+
+    return seconds;
+}
+
+static void *run(void *arg)
+{
+    bool *result = arg;
+    double per_level[DEPTHS_COUNT];
+    size_t base = DEPTHS_COUNT;
+
+    for (size_t i = 0; i < DEPTHS_COUNT; i++) {
+        char *path = write_input(depths[i]);
+        double best = 0;
+
+        for (size_t run = 0; run < NESTING_RUNS; run++) {
+            double seconds = parse(path);
+            if (seconds < 0) {
+                printf("depth %zu did not parse\n", depths[i]);
+                *result = false;
+                break;
+            }
+
+            if (run == 0 || seconds < best)
+                best = seconds;
+        }
+
+        unlink(path);
+        free(path);
+
+        per_level[i] = best / depths[i];
+        printf("depth %6zu %9.2f ms %7.1f ns/level\n", depths[i], 
+               best * 1e3, per_level[i] * 1e9);
+
+        // Shallow parses are too quick for their time to mean much
+        if (base == DEPTHS_COUNT && best >= NESTING_MIN_SECONDS)
+            base = i;
+    }
+
+    if (base < DEPTHS_COUNT && 
+        per_level[DEPTHS_COUNT - 1] > NESTING_MAX_SLOWDOWN * per_level[base]) {
+        printf("time per level grew %.1fx from depth %zu to %zu\n",
+               per_level[DEPTHS_COUNT - 1] / per_level[base], depths[base], 
+               depths[DEPTHS_COUNT - 1]);
+        *result = false;
+    }
+
+    return NULL;
+}
+
+int main()
+{
+    bool result = true;
+
+    log_init(true);
+    source_init();
+    ast_init();
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, NESTING_STACK_SIZE);
+
+    pthread_t thread;
+    int error = pthread_create(&thread, &attr, run, &result);
+    pthread_attr_destroy(&attr);
+    if (error != 0) {
+        printf("could not start the parsing thread: %s\n", strerror(error));
+        return 1;
+    }
+
+    pthread_join(thread, NULL);
+    ast_deinit();
+    source_deinit();
+
+    printf("%s\n", result ? "ok" : "failed");
+    return result ? 0 : 1;
+}
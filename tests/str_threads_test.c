@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../include/str.h"
+
+// Interns overlapping and disjoint strings from STR_TEST_THREADS threads
+// at once. Every string must get exactly one ID, IDs must stay dense, and
+// str_chars must give every string back, also while others are inserted.
+
+#define STR_TEST_THREADS 32
+#define STR_TEST_SHARED 20000
+#define STR_TEST_OWN 2000
+#define STR_TEST_ROUNDS 3
+
+typedef struct TestThread {
+    pthread_t thread;
+    size_t index;
+    StrId shared[STR_TEST_SHARED];
+    StrId own[STR_TEST_OWN];
+    bool error;
+} TestThread;
+
+static char shared_names[STR_TEST_SHARED][24];
+static char own_names[STR_TEST_THREADS][STR_TEST_OWN][24];
+static pthread_barrier_t start;
+
+static bool str_test_check(StrId id, char *name)
+{
+    char *chars = str_chars(id);
+    return str_len(chars) == strlen(name) && !strcmp(chars, name);
+}
+
+static void *str_test_run(void *arg)
+{
+    TestThread *thread = arg;
+    size_t offset = thread->index * STR_TEST_SHARED / STR_TEST_THREADS;
+
+    pthread_barrier_wait(&start);
+
+    // Every thread interns all shared names starting at its own offset,
+    // with one of its own names after every tenth
+    for (size_t i = 0, own = 0; i < STR_TEST_SHARED; i++) {
+        size_t j = (offset + i) % STR_TEST_SHARED;
+        thread->shared[j] = str_intern_null_term(shared_names[j]);
+        thread->error |= !str_test_check(thread->shared[j], shared_names[j]);
+
+        if (i % 10 == 0 && own < STR_TEST_OWN) {
+            char *name = own_names[thread->index][own];
+            thread->own[own] = str_intern_null_term(name);
+            thread->error |= !str_test_check(thread->own[own], name);
+            own++;
+        }
+    }
+
+    return NULL;
+}
+
+static bool str_test_round(TestThread *threads)
+{
+    size_t count = STR_TEST_SHARED + STR_TEST_THREADS * STR_TEST_OWN;
+    bool *is_seen = calloc(count, sizeof *is_seen);
+    bool result = true;
+
+    str_init(NULL, 0);
+    pthread_barrier_init(&start, NULL, STR_TEST_THREADS);
+
+    for (size_t i = 0; i < STR_TEST_THREADS; i++) {
+        threads[i].index = i;
+        threads[i].error = false;
+        pthread_create(&threads[i].thread, NULL, str_test_run, &threads[i]);
+    }
+
+    for (size_t i = 0; i < STR_TEST_THREADS; i++) {
+        pthread_join(threads[i].thread, NULL);
+        if (threads[i].error) {
+            printf("thread %zu: str_chars gave another string\n", i);
+            result = false;
+        }
+    }
+
+    pthread_barrier_destroy(&start);
+
+    for (size_t i = 0; i < STR_TEST_SHARED; i++) {
+        StrId id = threads[0].shared[i];
+
+        for (size_t j = 1; j < STR_TEST_THREADS; j++) {
+            if (threads[j].shared[i] != id) {
+                printf("\"%s\": ID %u in thread 0, %u in thread %zu\n",
+                       shared_names[i], id, threads[j].shared[i], j);
+                result = false;
+            }
+        }
+
+        if (id >= count || is_seen[id]) {
+            printf("\"%s\": ID %u out of range or taken\n", 
+                   shared_names[i], id);
+            result = false;
+        }
+        else
+            is_seen[id] = true;
+    }
+
+    for (size_t i = 0; i < STR_TEST_THREADS; i++) {
+        for (size_t j = 0; j < STR_TEST_OWN; j++) {
+            StrId id = threads[i].own[j];
+
+            if (id >= count || is_seen[id]) {
+                printf("\"%s\": ID %u out of range or taken\n", 
+                       own_names[i][j], id);
+                result = false;
+            }
+            else
+                is_seen[id] = true;
+
+            if (!str_test_check(id, own_names[i][j])) {
+                printf("\"%s\": str_chars gave \"%s\"\n", 
+                       own_names[i][j], str_chars(id));
+                result = false;
+            }
+        }
+    }
+
+    str_deinit();
+    free(is_seen);
+    return result;
+}
+
+int main()
+{
+    TestThread *threads = malloc(STR_TEST_THREADS * sizeof *threads);
+    bool result = true;
+
+    for (size_t i = 0; i < STR_TEST_SHARED; i++)
+        sprintf(shared_names[i], "shared_%zx", i * 2654435761u);
+
+    for (size_t i = 0; i < STR_TEST_THREADS; i++) {
+        for (size_t j = 0; j < STR_TEST_OWN; j++)
+            sprintf(own_names[i][j], "own%zu_%zu", i, j);
+    }
+
+    for (size_t i = 0; i < STR_TEST_ROUNDS && result; i++)
+        result = str_test_round(threads);
+
+    free(threads);
+    printf("%s\n", result ? "ok" : "failed");
+    return result ? 0 : 1;
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include "../include/type.h"
+#include "../include/token.h"
+
+// Pointer and array types must stay hash-consed when a forward declared
+// type they were built on is defined as a type that already exists.
+
+static bool result = true;
+
+static void expect(bool condition, char *what)
+{
+    if (!condition) {
+        printf("%s\n", what);
+        result = false;
+    }
+}
+
+static StrId name(char *chars)
+{
+    return str_intern_null_term(chars);
+}
+
+// A placeholder as the parser makes one for a name used before its typedef
+static Type *forward(char *chars)
+{
+    return type_add(name(chars));
+}
+
+int main()
+{
+    str_init(token_strings, TT_KEYWORD_COUNT);
+    type_init(target_default);
+
+    // typedef T* A; typedef int* Q; typedef int* T;
+    Type *a = type_pointer(name("A"), forward("T"));
+    Type *q = type_pointer(name("Q"), type_int);
+    Type *t = type_pointer(name("T"), type_int);
+    expect(t == q, "T is not int*");
+    expect(type_pointer_to(q) == a, "A is not the int** of Q*");
+    expect(a->child == q, "A does not point to int*");
+
+    // typedef U[4] B; typedef int* U;
+    Type *b = type_array(name("B"), forward("U"), 4);
+    Type *u = type_pointer(name("U"), type_int);
+    expect(u == q, "U is not int*");
+    expect(type_array_of(q, 4) == b, "B is not int*[4]");
+
+    // typedef int** W; typedef V* C; typedef C* D; typedef C[2] E;
+    // typedef int* V;
+    Type *w = type_pointer(name("W"), q);
+    Type *c = type_pointer(name("C"), forward("V"));
+    Type *d = type_pointer(name("D"), c);
+    Type *e = type_array(name("E"), c, 2);
+    Type *f = type_array_of(w, 2);
+    type_pointer(name("V"), type_int);
+    expect(type_canonical(c) == w, "C is not W");
+    expect(type_canonical(d) == type_pointer_to(w), "D is not int***");
+    expect(type_canonical(d)->child == w, "D does not point to W");
+    expect(type_canonical(e) == f, "E is not int**[2]");
+    expect(type_pointer_to(type_get(name("C"))) == type_canonical(d), 
+           "C* is not D");
+
+    // typedef S* G; typedef S* S;
+    Type *g = type_pointer(name("G"), forward("S"));
+    Type *s = type_pointer(name("S"), type_get(name("S")));
+    expect(s == g, "S is not G");
+    expect(g->child == g, "S does not point to itself");
+
+    type_deinit();
+    str_deinit();
+
+    printf("%s\n", result ? "ok" : "failed");
+    return result ? 0 : 1;
+}